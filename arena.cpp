@@ -0,0 +1,110 @@
+/*
+ * function arenas
+ *
+ * aralloc() hands out space from the newest chunk of an arena, starting a
+ * new chunk when it runs out; requests too large for an ordinary chunk get
+ * a chunk of their own.  Nothing is freed separately.  freearena() keeps up
+ * to ARENAKEEP ordinary chunks, frees the rest and puts the arena in a pool
+ * that newarena() takes from, so a run that has warmed up allocates almost
+ * nothing.  Arenas are filled by one thread at a time, but may be released
+ * on a different thread from the one that filled them.
+ */
+#include "arena.h"
+#include "misc.h"
+#include <cstddef>
+#include <cstdlib>
+#include <mutex>
+
+#define ARENAALIGN 16 /* alignment of every allocation */
+
+struct arenachunk {
+    struct arenachunk *next; /* next older chunk */
+    size_t size;             /* bytes in data */
+    alignas(ARENAALIGN) char data[1];
+};
+
+static struct arena *pool; /* recycled arenas */
+static std::mutex poollock;
+
+/*
+ * newchunk - start a new chunk with room for at least bytes
+ */
+static void newchunk(struct arena *a, size_t bytes) {
+    struct arenachunk *c;
+
+    if (bytes <= ARENACHUNK && a->spare) {
+        c = a->spare;
+        a->spare = c->next;
+    } else {
+        if (bytes < ARENACHUNK)
+            bytes = ARENACHUNK;
+        c = (struct arenachunk *) alloc(offsetof(struct arenachunk, data) +
+                                        bytes);
+        c->size = bytes;
+    }
+    c->next = a->chunks;
+    a->chunks = c;
+    a->cur = c->data;
+    a->end = c->data + c->size;
+}
+
+/*
+ * newarena - get an empty arena
+ */
+struct arena *newarena() {
+    struct arena *a = (struct arena *) NULL;
+
+    {
+        std::lock_guard<std::mutex> lk(poollock);
+        if (pool) {
+            a = pool;
+            pool = a->next;
+        }
+    }
+    if (!a) {
+        a = (struct arena *) alloc(sizeof(struct arena));
+        a->chunks = a->spare = (struct arenachunk *) NULL;
+    }
+    a->cur = a->end = (char *) NULL;
+    a->next = (struct arena *) NULL;
+    return a;
+}
+
+/*
+ * aralloc - allocate bytes from an arena
+ */
+void *aralloc(struct arena *a, size_t bytes) {
+    void *p;
+
+    bytes = (bytes + ARENAALIGN - 1) & ~(size_t) (ARENAALIGN - 1);
+    if (bytes > (size_t) (a->end - a->cur))
+        newchunk(a, bytes);
+    p = a->cur;
+    a->cur += bytes;
+    return p;
+}
+
+/*
+ * freearena - give back everything allocated from an arena at once
+ */
+void freearena(struct arena *a) {
+    struct arenachunk *c, *next;
+    int kept = 0;
+
+    for (c = a->spare; c; c = c->next)
+        kept++;
+    for (c = a->chunks; c; c = next) {
+        next = c->next;
+        if (c->size == ARENACHUNK && kept < ARENAKEEP) {
+            c->next = a->spare;
+            a->spare = c;
+            kept++;
+        } else
+            free(c);
+    }
+    a->chunks = (struct arenachunk *) NULL;
+
+    std::lock_guard<std::mutex> lk(poollock);
+    a->next = pool;
+    pool = a;
+}
@@ -0,0 +1,29 @@
+//
+// function arenas - the blocks, quads, item arrays and lists built for one
+// function all come from one arena, which is given back in one piece once
+// the function has been generated and recycled for a later function.
+//
+
+#ifndef QUADREADER_ARENA_H
+#define QUADREADER_ARENA_H
+
+#include <cstddef>
+
+#define ARENACHUNK (64 * 1024) /* bytes in an ordinary arena chunk */
+#define ARENAKEEP 16           /* ordinary chunks kept by a recycled arena */
+
+struct arenachunk;
+
+struct arena {
+    struct arenachunk *chunks; /* chunks in use, newest first */
+    struct arenachunk *spare;  /* ordinary chunks kept for reuse */
+    char *cur;                 /* next free byte of the newest chunk */
+    char *end;                 /* end of the newest chunk */
+    struct arena *next;        /* next arena in the recycled pool */
+};
+
+struct arena *newarena();
+void *aralloc(struct arena *, size_t);
+void freearena(struct arena *);
+
+#endif //QUADREADER_ARENA_H
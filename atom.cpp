@@ -0,0 +1,231 @@
+/*
+ * atoms
+ *
+ * The atom table is split into ATOMSHARDS chained hash tables, picked by
+ * the top bits of the hash, each with its own lock and its own storage, so
+ * reader threads rarely wait for each other.  Each thread also keeps a
+ * small direct-mapped cache of the atoms it has seen, which catches most
+ * repeated names without taking a lock at all.  Atoms are never freed, so
+ * a pointer to one stays valid for the whole run.
+ *
+ * Atom maps are small private tables keyed by atoms, for per-function
+ * indexes that must be emptied once per function at no cost.
+ */
+#include "atom.h"
+#include "misc.h"
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+struct atomshard {
+    std::mutex lock;
+    struct atom **buckets; /* chains, a power of two of them */
+    unsigned nbuckets;     /* number of chains */
+    unsigned count;        /* atoms in the shard */
+    char *cur;             /* free space for new atoms */
+    char *end;             /* end of that space */
+};
+
+static struct atomshard shards[ATOMSHARDS];
+static std::atomic<unsigned> nextid;
+static thread_local struct atom *cache[ATOMCACHE];
+
+/*
+ * hashstr - FNV-1a hash of len bytes of s
+ */
+unsigned hashstr(const char *s, size_t len) {
+    unsigned h = 2166136261u;
+
+    while (len--) {
+        h ^= (unsigned char) *s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/*
+ * tempnumber - return N if len bytes of s spell the temporary tN, else -1
+ */
+static int tempnumber(const char *s, size_t len) {
+    int n = 0;
+    size_t i;
+
+    if (len < 2 || len > 10 || s[0] != 't' || (s[1] == '0' && len > 2))
+        return -1;
+    for (i = 1; i < len; i++) {
+        if (s[i] < '0' || s[i] > '9')
+            return -1;
+        n = 10 * n + (s[i] - '0');
+    }
+    return n;
+}
+
+/*
+ * growshard - double the number of chains in a shard
+ */
+static void growshard(struct atomshard *sh) {
+    struct atom **old = sh->buckets, *a, *next;
+    unsigned i, n = sh->nbuckets;
+
+    sh->nbuckets = n ? 2 * n : 256;
+    sh->buckets = (struct atom **) alloc(sh->nbuckets * sizeof(struct atom *));
+    memset(sh->buckets, 0, sh->nbuckets * sizeof(struct atom *));
+    for (i = 0; i < n; i++)
+        for (a = old[i]; a; a = next) {
+            next = a->next;
+            a->next = sh->buckets[a->hash & (sh->nbuckets - 1)];
+            sh->buckets[a->hash & (sh->nbuckets - 1)] = a;
+        }
+    free(old);
+}
+
+/*
+ * newatom - allocate an atom for len bytes of s
+ */
+static struct atom *newatom(struct atomshard *sh, const char *s, size_t len,
+                            unsigned h) {
+    struct atom *a;
+    size_t size;
+
+    size = offsetof(struct atom, name) + len + 1;
+    size = (size + alignof(struct atom) - 1) & ~(alignof(struct atom) - 1);
+    if (size > (size_t) (sh->end - sh->cur)) {
+        if (size > ATOMCHUNK / 4) {
+            a = (struct atom *) alloc(size);
+            goto fill;
+        }
+        sh->cur = (char *) alloc(ATOMCHUNK);
+        sh->end = sh->cur + ATOMCHUNK;
+    }
+    a = (struct atom *) sh->cur;
+    sh->cur += size;
+
+fill:
+    a->hash = h;
+    a->id = nextid++;
+    a->temp = tempnumber(s, len);
+    a->len = len;
+    memcpy(a->name, s, len);
+    a->name[len] = '\0';
+    return a;
+}
+
+/*
+ * intern - return the atom for len bytes of s
+ */
+struct atom *intern(const char *s, size_t len) {
+    unsigned h = hashstr(s, len);
+    struct atom **slot = &cache[h & (ATOMCACHE - 1)], *a = *slot, **q;
+    struct atomshard *sh;
+
+    if (a && a->hash == h && a->len == len && memcmp(a->name, s, len) == 0)
+        return a;
+
+    sh = &shards[h >> 26];
+    {
+        std::lock_guard<std::mutex> lk(sh->lock);
+        if (sh->count >= sh->nbuckets)
+            growshard(sh);
+        for (q = &sh->buckets[h & (sh->nbuckets - 1)]; (a = *q); q = &a->next)
+            if (a->hash == h && a->len == len &&
+                memcmp(a->name, s, len) == 0)
+                break;
+        if (!a) {
+            a = newatom(sh, s, len, h);
+            a->next = (struct atom *) NULL;
+            *q = a;
+            sh->count++;
+        }
+    }
+    *slot = a;
+    return a;
+}
+
+/*
+ * internstr - intern a string and return its interned copy
+ */
+char *internstr(const char *s) {
+    return intern(s, strlen(s))->name;
+}
+
+/*
+ * natoms - number of atoms interned so far
+ */
+unsigned natoms() {
+    return nextid;
+}
+
+/*
+ * amslot - return the slot of name, or the free slot where it belongs
+ */
+static struct amslot *amslot(struct atommap *m, char *name) {
+    unsigned i;
+
+    for (i = atomof(name)->hash & m->mask; m->slots[i].gen == m->gen;
+         i = (i + 1) & m->mask)
+        if (m->slots[i].name == name)
+            break;
+    return &m->slots[i];
+}
+
+/*
+ * amgrow - double the slots of a map, or give it its first ones
+ */
+static void amgrow(struct atommap *m) {
+    struct amslot *old = m->slots;
+    unsigned i, n = old ? m->mask + 1 : 0;
+
+    m->mask = n ? 2 * n - 1 : 255;
+    m->slots = (struct amslot *) alloc((m->mask + 1) * sizeof(struct amslot));
+    memset(m->slots, 0, (m->mask + 1) * sizeof(struct amslot));
+    for (i = 0; i < n; i++)
+        if (old[i].gen == m->gen)
+            *amslot(m, old[i].name) = old[i];
+    free(old);
+}
+
+/*
+ * amreset - empty a map
+ */
+void amreset(struct atommap *m) {
+    if (++m->gen == 0) {
+        /* the generation wrapped; old slots could look current */
+        if (m->slots)
+            memset(m->slots, 0, (m->mask + 1) * sizeof(struct amslot));
+        m->gen = 1;
+    }
+    m->count = 0;
+}
+
+/*
+ * amfind - return where the value of name is kept, or NULL if it has none
+ */
+void **amfind(struct atommap *m, char *name) {
+    struct amslot *sp;
+
+    if (!m->slots)
+        return (void **) NULL;
+    sp = amslot(m, name);
+    return sp->gen == m->gen ? &sp->val : (void **) NULL;
+}
+
+/*
+ * amadd - give name the value val, unless it already has one
+ */
+bool amadd(struct atommap *m, char *name, void *val) {
+    struct amslot *sp;
+
+    if (m->gen == 0)
+        amreset(m);
+    if (!m->slots || 2 * (m->count + 1) > m->mask + 1)
+        amgrow(m);
+    sp = amslot(m, name);
+    if (sp->gen == m->gen)
+        return false;
+    sp->name = name;
+    sp->val = val;
+    sp->gen = m->gen;
+    m->count++;
+    return true;
+}
@@ -0,0 +1,54 @@
+//
+// atoms - every distinct identifier, temporary, label and other quad item
+// is interned once, so two items name the same thing exactly when they are
+// the same pointer.  Interning is safe from any thread.
+//
+
+#ifndef QUADREADER_ATOM_H
+#define QUADREADER_ATOM_H
+
+#include <cstddef>
+
+#define ATOMSHARDS 64   /* independently locked parts of the atom table */
+#define ATOMCACHE 4096  /* atoms remembered by each thread */
+#define ATOMCHUNK 65536 /* bytes of atoms allocated at a time */
+
+struct atom {
+    struct atom *next; /* next atom in the same bucket */
+    unsigned hash;     /* hash of name */
+    unsigned id;       /* dense number, in order of interning */
+    int temp;          /* N if the name is the temporary tN, else -1 */
+    unsigned len;      /* length of name */
+    char name[1];      /* the string, allocated to fit */
+};
+
+/*
+ * map from interned names to pointers, open-addressed; a slot is in use
+ * only if it carries the map's generation, so amreset() empties the map
+ * without touching the slots
+ */
+struct amslot {
+    char *name; /* interned name */
+    void *val;  /* value stored for it */
+    unsigned gen; /* generation the slot was filled in */
+};
+
+struct atommap {
+    struct amslot *slots; /* the slots, a power of two of them */
+    unsigned mask;        /* number of slots - 1 */
+    unsigned count;       /* names in the map */
+    unsigned gen;         /* current generation, 0 before first use */
+};
+
+/* the atom of a name returned by intern() or internstr() */
+#define atomof(s) ((struct atom *) ((s) - offsetof(struct atom, name)))
+
+struct atom *intern(const char *, size_t);
+char *internstr(const char *);
+unsigned hashstr(const char *, size_t);
+unsigned natoms();
+void amreset(struct atommap *);
+void **amfind(struct atommap *, char *);
+bool amadd(struct atommap *, char *, void *);
+
+#endif //QUADREADER_ATOM_H
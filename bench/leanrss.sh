@@ -0,0 +1,20 @@
+#!/bin/sh
+#
+# leanrss.sh - peak RSS of cgen.exe with and without -lean on a generated
+#              input
+#
+#   leanrss.sh cgen.exe genquads
+#
+# The peak RSS is the one cgen.exe reports itself (-time), for the whole
+# module at once, for -stream, which -lean implies, and for -lean.
+#
+cgen=$1
+gen=$2
+. "$(dirname "$0")/../tests/common.sh"
+
+benchinput lean
+for opt in "" -stream -lean; do
+    "$cgen" -time $opt "$dir/in.sem" 2>&1 >/dev/null |
+        awk -v opt="${opt:-default}" \
+            '/^memory/ { printf "memory  %8.1f MB peak RSS, %s\n", $2, opt }'
+done
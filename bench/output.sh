@@ -0,0 +1,22 @@
+#!/bin/sh
+#
+# output.sh - time and size of the module written as bitcode and as text,
+#             on a generated input
+#
+#   output.sh cgen.exe genquads
+#
+# Both are written with -o to a file; the times and sizes are the ones
+# cgen.exe reports itself (-time).  Bitcode is also written with a module
+# summary index, and text on standard output, for comparison.
+#
+cgen=$1
+gen=$2
+. "$(dirname "$0")/../tests/common.sh"
+
+benchinput output
+"$cgen" -time -o "$dir/out.bc" "$dir/in.sem" 2>&1 | grep '^output'
+"$cgen" -time -summary -o "$dir/out.bc" "$dir/in.sem" 2>&1 |
+    awk '/^output/ { print $0 ", summary" }'
+"$cgen" -time -S -o "$dir/out.ll" "$dir/in.sem" 2>&1 | grep '^output'
+"$cgen" -time "$dir/in.sem" 2>&1 > "$dir/out.ll" |
+    awk '/^output/ { print $0 ", standard output" }'
@@ -0,0 +1,20 @@
+#!/bin/sh
+#
+# parse.sh - parse throughput of the quad reader on a generated input
+#
+#   parse.sh cgen.exe genquads
+#
+# Reports the parse time and rate cgen.exe measures itself (-time) for each
+# scanner and for the parallel reader.
+#
+cgen=$1
+gen=$2
+. "$(dirname "$0")/../tests/common.sh"
+
+benchinput parse
+for scan in scalar sse2 avx2; do
+    "$cgen" -time -scan "$scan" "$dir/in.sem" 2>&1 >/dev/null |
+        grep '^parse' || echo "parse   (no $scan)"
+done
+"$cgen" -time -j 4 "$dir/in.sem" 2>&1 >/dev/null | grep '^parse'
+
@@ -0,0 +1,19 @@
+#!/bin/sh
+#
+# qbinload.sh - load time of binary quads against parse time of the same
+#               program as text, on a generated input
+#
+#   qbinload.sh cgen.exe genquads
+#
+# Both times are the ones cgen.exe measures itself (-time); the conversion
+# time and the size of both files are reported too.
+#
+cgen=$1
+gen=$2
+. "$(dirname "$0")/../tests/common.sh"
+
+benchinput qbin
+"$cgen" -time -emit-qbin "$dir/in.qb" "$dir/in.sem" 2>&1 | grep '^convert'
+echo "qbin: $(wc -c < "$dir/in.qb") bytes binary"
+"$cgen" -time "$dir/in.sem" 2>&1 >/dev/null | grep '^parse'
+"$cgen" -time "$dir/in.qb" 2>&1 >/dev/null | grep '^load'
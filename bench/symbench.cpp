@@ -0,0 +1,102 @@
+/*
+ * symbench - install and lookup throughput of the symbol table
+ *
+ *   symbench [count ...]
+ *
+ * For each count (1000, 100000 and 1000000 if none are given), installs
+ * that many distinct names in a block, looks each of them up, looks up as
+ * many names that were never installed, and leaves the block.  The names
+ * are interned beforehand, as the reader does, so only the table is timed.
+ */
+#include "misc.h"
+#include "quad.h"
+#include "sym.h"
+#include "atom.h"
+#include <cstdio>
+#include <cstdlib>
+
+/* misc.cpp manages the function being read through these */
+thread_local struct bblk *top = (struct bblk *) NULL;
+thread_local struct bblk *bot = (struct bblk *) NULL;
+thread_local struct bplist *gbp = (struct bplist *) NULL;
+thread_local struct arena *farena = (struct arena *) NULL;
+thread_local struct cfg gcfg;
+
+#define LOOKUPS 10000000 /* lookups of each kind timed for every count */
+
+/*
+ * names - intern n distinct names starting with the given prefix
+ */
+static char **names(const char *prefix, int n) {
+    char **v, buf[32];
+    int i;
+
+    v = (char **) alloc(n * sizeof(char *));
+    for (i = 0; i < n; i++) {
+        snprintf(buf, sizeof(buf), "%s%d", prefix, i);
+        v[i] = internstr(buf);
+    }
+    return v;
+}
+
+/*
+ * bench - time the table on n names and print the cost of each operation
+ */
+static void bench(int n) {
+    char **in = names("v", n), **out = names("w", n);
+    double t, tinstall, thit, tmiss, tleave;
+    long found = 0, lookups;
+    int i, r, rounds;
+
+    rounds = LOOKUPS / n > 0 ? LOOKUPS / n : 1;
+    lookups = (long) rounds * n;
+
+    enterblock();
+    t = elapsed();
+    for (i = 0; i < n; i++)
+        install(in[i], -1);
+    tinstall = elapsed() - t;
+
+    t = elapsed();
+    for (r = 0; r < rounds; r++)
+        for (i = 0; i < n; i++)
+            found += lookup(in[i], 0) != NULL;
+    thit = elapsed() - t;
+
+    t = elapsed();
+    for (r = 0; r < rounds; r++)
+        for (i = 0; i < n; i++)
+            found += lookup(out[i], 0) != NULL;
+    tmiss = elapsed() - t;
+
+    t = elapsed();
+    leaveblock();
+    tleave = elapsed() - t;
+
+    if (found != lookups) {
+        fprintf(stderr, "symbench: %ld of %ld names found\n", found, lookups);
+        quit(1);
+    }
+    printf("symbols %8d  install %6.1f ns  lookup %6.1f ns, "
+           "miss %6.1f ns  leave %6.1f ns\n", n, tinstall * 1e9 / n,
+           thit * 1e9 / lookups, tmiss * 1e9 / lookups, tleave * 1e9 / n);
+    free(in);
+    free(out);
+}
+
+int main(int argc, char *argv[]) {
+    static int counts[] = {1000, 100000, 1000000};
+    int i, n;
+
+    if (argc == 1)
+        for (i = 0; i < (int) (sizeof(counts) / sizeof(counts[0])); i++)
+            bench(counts[i]);
+    for (i = 1; i < argc; i++) {
+        if ((n = atoi(argv[i])) <= 0) {
+            fprintf(stderr, "usage: %s [count ...]\n", argv[0]);
+            return 1;
+        }
+        bench(n);
+    }
+    return 0;
+}
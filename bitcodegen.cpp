@@ -10,11 +10,22 @@
 #include <iostream>
 #include "quad.h"
 #include "sym.h"
+#include "atom.h"
+#include "misc.h"
 
 #include "llvm/ADT/APFloat.h"
 #include "llvm/ADT/Optional.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Analysis/ModuleSummaryAnalysis.h"
+#include "llvm/Analysis/ProfileSummaryInfo.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ExecutionEngine/Orc/ObjectLinkingLayer.h"
+#include "bitcodegen.h"
 #include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/CFG.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Function.h"
@@ -23,18 +34,24 @@
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/ModuleSlotTracker.h"
+#include "llvm/IR/PassManager.h"
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Host.h"
+#include "llvm/Support/Program.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/MC/TargetRegistry.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Passes/PassBuilder.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Target/TargetOptions.h"
 #include <algorithm>
 #include <cassert>
 #include <cctype>
+#include <climits>
 #include <cstdio>
 #include <cstdlib>
 #include <map>
@@ -52,9 +69,21 @@ typedef SmallVector<Value *, 16> ValList;
 /*
  * The order of the declaration of static variables matter.
  */
-static LLVMContext TheContext;
+static LLVMContext &TheContext = *new LLVMContext; /* the JIT can own it */
 static IRBuilder<> Builder(TheContext);
 static std::unique_ptr<Module> TheModule;
+static bool streaming; /* print functions as they are generated */
+static std::unique_ptr<raw_fd_ostream> outfile; /* -o file, or NULL */
+static enum outformat outfmt; /* what the module is written as */
+static bool summary;          /* bitcode with a module summary index */
+static std::string exename;   /* executable linked from the object file */
+static SmallString<128> objname; /* its temporary object file */
+static TargetMachine *TheTargetMachine;
+static const OptimizationLevel *optlevel; /* -O pipeline, NULL for none */
+static CodeGenOpt::Level cglevel = CodeGenOpt::None; /* native code's */
+static double optseconds;                 /* time spent in it */
+static std::vector<Value *> temps; /* values of the function's temporaries */
+static int tempbase;               /* number of the first temporary in temps */
 
 /* https://llvm.org/docs/tutorial/MyFirstLanguageFrontend/LangImpl08.html#choosing-a-target */
 void InitializeModuleAndPassManager() {
@@ -73,18 +102,19 @@ void InitializeModuleAndPassManager() {
     auto CPU = "generic";
     auto Features = "";
     TargetOptions opt;
-    auto RM = Optional<Reloc::Model>();
-    auto TargetMachine = Target->createTargetMachine(
+    /* position independent, so the objects link into PIE executables */
+    auto RM = Optional<Reloc::Model>(Reloc::PIC_);
+    TheTargetMachine = Target->createTargetMachine(
             TargetTriple, CPU, Features, opt, RM);
 
     // Open a new module.
     TheModule = std::make_unique<Module>("QuadReader", TheContext);
-    TheModule->setDataLayout(TargetMachine->createDataLayout());
+    TheModule->setDataLayout(TheTargetMachine->createDataLayout());
     TheModule->setTargetTriple(TargetTriple);
 
     // We rely on printf function call
     char str[] = "printf";
-    struct id_entry *iptr = install(str, GLOBAL);
+    struct id_entry *iptr = install(internstr(str), GLOBAL);
     FunctionType* printfTy = FunctionType::get(Builder.getInt32Ty(),
                                                Builder.getInt8PtrTy(), true);
     iptr->v.f = Function::Create(printfTy,Function::ExternalLinkage,
@@ -94,7 +124,7 @@ void InitializeModuleAndPassManager() {
 
     // exit function call
     char str2[] = "exit";
-    iptr = install(str2, GLOBAL);
+    iptr = install(internstr(str2), GLOBAL);
     FunctionType* exitfTy = FunctionType::get(Builder.getVoidTy(), Builder.getInt32Ty(), false);
     iptr->v.f = Function::Create(exitfTy, Function::ExternalLinkage, str2, *TheModule);
     iptr->v.f->setCallingConv(CallingConv::C);
@@ -102,15 +132,391 @@ void InitializeModuleAndPassManager() {
 
     // getchar function call
     char str4[] = "getchar";
-    iptr = install(str4, GLOBAL);
+    iptr = install(internstr(str4), GLOBAL);
     FunctionType* getcharTy = FunctionType::get(Builder.getInt32Ty(), false);
     iptr->v.f = Function::Create(getcharTy, Function::ExternalLinkage, str4, *TheModule);
     iptr->v.f->setCallingConv(CallingConv::C);
     //iptr->v.f->getArg(0)->setName("f");
 }
 
-void OutputModule() {
-    TheModule->print(outs(), nullptr);
+/*
+ * DiscardValueNames - stop naming instructions, arguments and blocks after
+ *                     their quad operands; globals and functions keep theirs.
+ *                     Must be called before the module is created.
+ */
+void DiscardValueNames() {
+    TheContext.setDiscardValueNames(true);
+}
+
+/*
+ * SetOptLevel - run the -O pipeline of the given level ("0", "1", "2", "3"
+ *               or "s") before output, and generate native code at the
+ *               matching level; -O0 runs none.  False if there is no such
+ *               level.
+ */
+bool SetOptLevel(const char *level) {
+    static const struct {
+        const char *name;
+        const OptimizationLevel *level;
+        CodeGenOpt::Level cglevel;
+    } levels[] = {
+            {"0", nullptr, CodeGenOpt::None},
+            {"1", &OptimizationLevel::O1, CodeGenOpt::Less},
+            {"2", &OptimizationLevel::O2, CodeGenOpt::Default},
+            {"3", &OptimizationLevel::O3, CodeGenOpt::Aggressive},
+            {"s", &OptimizationLevel::Os, CodeGenOpt::Default},
+    };
+
+    for (auto &l : levels)
+        if (strcmp(level, l.name) == 0) {
+            optlevel = l.level;
+            cglevel = l.cglevel;
+            return true;
+        }
+    return false;
+}
+
+/* the pass and analysis managers for the -O pipeline, set up once */
+struct optimizer {
+    LoopAnalysisManager LAM;
+    FunctionAnalysisManager FAM;
+    CGSCCAnalysisManager CGAM;
+    ModuleAnalysisManager MAM;
+    PassBuilder PB;
+    FunctionPassManager FPM; /* function simplification, for streaming */
+
+    optimizer() : PB(TheTargetMachine) {
+        /* a library call simplified into another one would need a new
+           declaration after earlier functions have been printed */
+        if (streaming)
+            FAM.registerPass([] {
+                TargetLibraryInfoImpl TLII(
+                        Triple(TheModule->getTargetTriple()));
+                TLII.disableAllFunctions();
+                return TargetLibraryAnalysis(TLII);
+            });
+        PB.registerModuleAnalyses(MAM);
+        PB.registerCGSCCAnalyses(CGAM);
+        PB.registerFunctionAnalyses(FAM);
+        PB.registerLoopAnalyses(LAM);
+        PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+        if (streaming)
+            FPM = PB.buildFunctionSimplificationPipeline(
+                    *optlevel, ThinOrFullLTOPhase::None);
+    }
+};
+
+static std::unique_ptr<optimizer> theoptimizer;
+
+static optimizer *getoptimizer() {
+    if (!theoptimizer)
+        theoptimizer = std::make_unique<optimizer>();
+    return theoptimizer.get();
+}
+
+/*
+ * OptimizeFunction - run the function simplification pipeline on a
+ *                    function about to be streamed out; the module
+ *                    pipeline needs the whole module
+ */
+static void OptimizeFunction(Function &F) {
+    optimizer *O;
+    double t;
+
+    if (!optlevel || F.isDeclaration())
+        return;
+    t = elapsed();
+    O = getoptimizer();
+    O->FPM.run(F, O->FAM);
+    O->FAM.clear(F, F.getName());
+    optseconds += elapsed() - t;
+}
+
+/*
+ * OptimizeModule - run the module pipeline of the -O level on the whole
+ *                  module, unless its functions were streamed out; returns
+ *                  the seconds spent optimizing in all
+ */
+double OptimizeModule() {
+    optimizer *O;
+    ModulePassManager MPM;
+    double t;
+
+    if (optlevel && !streaming) {
+        t = elapsed();
+        O = getoptimizer();
+        MPM = O->PB.buildPerModuleDefaultPipeline(*optlevel);
+        MPM.run(*TheModule, O->MAM);
+        optseconds += elapsed() - t;
+    }
+    return optseconds;
+}
+
+#define OUTBUFSIZE (1 << 20) /* output buffer size */
+
+/*
+ * output - the stream the module goes to
+ */
+static raw_fd_ostream &output() {
+    return outfile ? *outfile : outs();
+}
+
+/*
+ * OpenOutput - send the module to the named file ("-" is standard output),
+ *              or to standard output if name is NULL, in the given format;
+ *              bitcode optionally with a module summary index.  An
+ *              executable is linked from an object file written to a
+ *              temporary file.  False if the file cannot be opened.
+ */
+bool OpenOutput(const char *name, enum outformat fmt, bool withsummary) {
+    std::error_code EC;
+    int fd;
+
+    outfmt = fmt;
+    summary = fmt == OUT_BITCODE && withsummary;
+    if (fmt == OUT_EXE) {
+        exename = name;
+        EC = sys::fs::createTemporaryFile("cgen", "o", fd, objname);
+        if (!EC)
+            outfile = std::make_unique<raw_fd_ostream>(fd, true);
+        name = objname.c_str();
+    } else if (name)
+        outfile = std::make_unique<raw_fd_ostream>(
+                name, EC, fmt == OUT_TEXT || fmt == OUT_ASM ? sys::fs::OF_Text
+                                                           : sys::fs::OF_None);
+    if (EC) {
+        errs() << name << ": " << EC.message() << "\n";
+        outfile.reset();
+        return false;
+    }
+    output().SetBufferSize(OUTBUFSIZE);
+    return true;
+}
+
+/*
+ * EmitNative - generate an object file or assembly for the module with
+ *              the target machine the module was made for.  An object file
+ *              is patched up as it is written, so one going to a pipe is
+ *              built in memory first.
+ */
+static void EmitNative(raw_fd_ostream &out) {
+    legacy::PassManager PM;
+    SmallVector<char, 0> buf;
+    raw_svector_ostream bufout(buf);
+    bool inmemory = outfmt != OUT_ASM && !out.supportsSeeking();
+
+    TheTargetMachine->setOptLevel(cglevel);
+    if (TheTargetMachine->addPassesToEmitFile(
+            PM, inmemory ? (raw_pwrite_stream &) bufout : out, nullptr,
+            outfmt == OUT_ASM ? CGFT_AssemblyFile : CGFT_ObjectFile)) {
+        errs() << "the target cannot emit this file type\n";
+        exit(1);
+    }
+    PM.run(*TheModule);
+    if (inmemory)
+        out << buf;
+}
+
+/*
+ * Link - link the object file into the executable with the system C
+ *        compiler driver, which knows where the C library and the start
+ *        files are, then remove the object file
+ */
+static void Link() {
+    std::string msg;
+    int rc;
+
+    auto cc = sys::findProgramByName("cc");
+    if (!cc) {
+        errs() << "cannot find cc: " << cc.getError().message() << "\n";
+        sys::fs::remove(objname);
+        exit(1);
+    }
+    StringRef args[] = {*cc, "-o", exename, objname};
+    rc = sys::ExecuteAndWait(*cc, args, None, {}, 0, 0, &msg);
+    sys::fs::remove(objname);
+    if (rc != 0) {
+        errs() << "cannot link " << exename;
+        if (!msg.empty())
+            errs() << ": " << msg;
+        errs() << "\n";
+        exit(1);
+    }
+}
+
+/*
+ * RunModule - compile the module with an ORC JIT at the -O level and call
+ *             its main; returns main's result and the seconds spent
+ *             compiling and running.  Anything the module calls outside
+ *             itself, printf, exit and getchar or a library call the
+ *             optimizer put in, is looked up in this process.  An exit()
+ *             called by the program ends this process too.
+ */
+int RunModule(double *compile, double *run) {
+    double t;
+    int rc;
+
+    auto fail = [](Error E) {
+        errs() << "cannot run the module: " << toString(std::move(E))
+               << "\n";
+        exit(1);
+    };
+
+    t = elapsed();
+    auto JTMB = orc::JITTargetMachineBuilder::detectHost();
+    if (!JTMB)
+        fail(JTMB.takeError());
+    JTMB->setCodeGenOptLevel(cglevel);
+    /* JITLink reaches far symbols through stubs, so the small code model,
+       which is quicker to generate than the large default, is safe */
+    JTMB->setCodeModel(CodeModel::Small);
+    JTMB->setRelocationModel(Reloc::PIC_);
+    auto J = orc::LLJITBuilder()
+            .setJITTargetMachineBuilder(std::move(*JTMB))
+            .setObjectLinkingLayerCreator(
+                    [](orc::ExecutionSession &ES, const Triple &)
+                            -> Expected<std::unique_ptr<orc::ObjectLayer>> {
+                        return std::make_unique<orc::ObjectLinkingLayer>(ES);
+                    })
+            .create();
+    if (!J)
+        fail(J.takeError());
+    auto G = orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+            (*J)->getDataLayout().getGlobalPrefix());
+    if (!G)
+        fail(G.takeError());
+    (*J)->getMainJITDylib().addGenerator(std::move(*G));
+
+    /* the JIT takes the module and its context; the optimizer's cached
+       analyses refer to the module, so they go first */
+    theoptimizer.reset();
+    if (Error E = (*J)->addIRModule(orc::ThreadSafeModule(
+            std::move(TheModule),
+            orc::ThreadSafeContext(std::unique_ptr<LLVMContext>(&TheContext)))))
+        fail(std::move(E));
+    auto Main = (*J)->lookup("main");
+    if (!Main)
+        fail(Main.takeError());
+    *compile = elapsed() - t;
+
+    t = elapsed();
+    rc = ((int (*)()) Main->getAddress())();
+    fflush(stdout);
+    *run = elapsed() - t;
+    return rc;
+}
+
+/*
+ * StreamModule - print each function as soon as it is generated instead of
+ *                the whole module at the end; prints the module header
+ */
+void StreamModule() {
+    raw_ostream &out = output();
+
+    out << "; ModuleID = '" << TheModule->getModuleIdentifier() << "'\n";
+    out << "source_filename = \"";
+    printEscapedString(TheModule->getSourceFileName(), out);
+    out << "\"\n";
+    out << "target datalayout = \"" << TheModule->getDataLayoutStr()
+        << "\"\n";
+    out << "target triple = \"" << TheModule->getTargetTriple() << "\"\n";
+    streaming = true;
+}
+
+/*
+ * StreamFunction - print the globals and functions added to the module since
+ *                  the last call, then drop the function bodies, leaving
+ *                  declarations for later calls, and the string constants
+ *                  only they used.  Unnamed constants are given names first
+ *                  so that numbering never depends on what was dropped, which
+ *                  lets one slot tracker serve the whole run.  The new
+ *                  functions are optimized first, see OptimizeFunction().
+ */
+static void StreamFunction() {
+    static std::unique_ptr<ModuleSlotTracker> MST;
+    static GlobalVariable *lastglobal;
+    static Function *lastfunc;
+    static unsigned nstrings;
+    std::vector<GlobalVariable *> printed;
+    Module::global_iterator g;
+    Module::iterator f, first;
+    raw_ostream &out = output();
+
+    first = lastfunc ? std::next(lastfunc->getIterator()) : TheModule->begin();
+    for (f = first; f != TheModule->end(); ++f)
+        OptimizeFunction(*f);
+
+    g = lastglobal ? std::next(lastglobal->getIterator())
+                   : TheModule->global_begin();
+    for (; g != TheModule->global_end(); ++g) {
+        if (!g->hasName())
+            g->setName(".str." + Twine(nstrings++));
+        printed.push_back(&*g);
+    }
+    if (!MST)
+        MST = std::make_unique<ModuleSlotTracker>(TheModule.get());
+
+    if (!printed.empty())
+        out << '\n';
+    for (auto gv : printed) {
+        gv->print(out, *MST);
+        out << '\n';
+    }
+
+    for (f = first; f != TheModule->end(); ++f) {
+        out << '\n';
+        f->Value::print(out, *MST);
+        if (!f->isDeclaration())
+            f->deleteBody();
+        lastfunc = &*f;
+    }
+
+    for (auto gv : printed) {
+        gv->removeDeadConstantUsers();
+        if (gv->hasPrivateLinkage() && gv->use_empty())
+            gv->eraseFromParent();
+    }
+    lastglobal = TheModule->global_empty() ? (GlobalVariable *) NULL
+                                           : &TheModule->getGlobalList().back();
+}
+
+/*
+ * OutputModule - write the rest of the module, and link it if an
+ *                executable was asked for; returns the number of bytes
+ *                written in all
+ */
+uint64_t OutputModule() {
+    raw_ostream &out = output();
+    uint64_t n;
+
+    if (streaming)
+        StreamFunction();
+    else if (outfmt == OUT_BITCODE && summary) {
+        ProfileSummaryInfo PSI(*TheModule);
+        ModuleSummaryIndex Index =
+                buildModuleSummaryIndex(*TheModule, nullptr, &PSI);
+        WriteBitcodeToFile(*TheModule, out, false, &Index);
+    } else if (outfmt == OUT_BITCODE)
+        WriteBitcodeToFile(*TheModule, out);
+    else if (outfmt == OUT_TEXT)
+        TheModule->print(out, nullptr);
+    else
+        EmitNative(output());
+    out.flush();
+    if (outfile && outfile->has_error()) {
+        errs() << "cannot write output: " << outfile->error().message()
+               << "\n";
+        outfile->clear_error();
+        if (outfmt == OUT_EXE)
+            sys::fs::remove(objname);
+        exit(1);
+    }
+    n = out.tell();
+    if (outfmt == OUT_EXE) {
+        outfile->close();
+        Link();
+    }
+    return n;
 }
 
 static void createGlobal(struct id_entry *iptr) {
@@ -146,8 +552,7 @@ static void createFunction(struct id_entry *fn, struct quadline **ptr) {
     std::vector<llvm::Type *> typeVec;
 
     for (*ptr = (*ptr)->next; *ptr && (*ptr)->type == FORMAL_ALLOC; *ptr = (*ptr)->next) {
-        auto iptr = lookup((*ptr)->items[1], PARAM);
-        assert(iptr && "parameter is missing");
+        auto iptr = (*ptr)->res.id;
         if (iptr->i_type & T_INT) {
             iptr->u.ltype = Builder.getInt32Ty();
         }
@@ -175,30 +580,284 @@ static void createFunction(struct id_entry *fn, struct quadline **ptr) {
     fn->v.f = F;
 }
 
+/*
+ * Scalar locals and formals whose address is only ever loaded from and
+ * stored to live in SSA values instead of memory, built as in Braun et al.,
+ * "Simple and Efficient Construction of Static Single Assignment Form": a
+ * load reads the variable's current definition in its block, looking back
+ * through the predecessors in the cfg and placing phis at joins.  Blocks
+ * are generated in order, and a block is sealed - its incomplete phis get
+ * their operands - once all of its predecessors have been generated.
+ */
+struct varphi {
+    struct id_entry *var; /* variable the phi merges */
+    PHINode *phi;
+    unsigned blk;         /* number of the block it starts */
+};
+
+static std::vector<struct id_entry *> tempvar; /* variable a temporary addresses */
+static std::vector<DenseMap<struct id_entry *, Value *>> curdef; /* by block */
+static std::vector<SmallVector<struct varphi, 4>>
+        incomplete;                    /* phis of unsealed blocks */
+static std::vector<struct varphi> pending; /* phis still without operands */
+static std::vector<unsigned> unfilled; /* predecessors not yet generated */
+static std::vector<PHINode *> phis;    /* every phi placed */
+static unsigned curblk;                /* number of the block being generated */
+extern thread_local struct cfg gcfg;
+
+/*
+ * findssavars - decide which variables live in SSA values: scalar locals
+ *               and formals referenced only by address temporaries that
+ *               are defined once and used only as load or store addresses
+ */
+static void findssavars() {
+    struct bblk *blk;
+    struct quadline *ptr;
+    struct id_entry *var;
+    std::vector<unsigned char> ndefs(temps.size(), 0);
+    int i, n;
+    extern thread_local struct bblk *top;
+
+    tempvar.assign(temps.size(), nullptr);
+    for (blk = top; blk; blk = blk->down)
+        for (ptr = blk->lines; ptr; ptr = ptr->next) {
+            if (ptr->res.kind != O_TEMP || ptr->res.id)
+                continue;
+            n = ptr->res.num - tempbase;
+            if (ndefs[n] < 2)
+                ndefs[n]++;
+            if (ptr->type != LOCAL_REF && ptr->type != PARAM_REF)
+                continue;
+            var = ptr->opnds[0].id;
+            if (!(var->i_type & T_ARRAY) &&
+                (var->i_scope == LOCAL || var->i_scope == PARAM)) {
+                tempvar[n] = var;
+                var->i_ssa = true;
+            }
+        }
+
+    /* anything else done with the address lets the variable escape */
+    for (blk = top; blk; blk = blk->down)
+        for (ptr = blk->lines; ptr; ptr = ptr->next) {
+            if ((ptr->type == LOCAL_REF || ptr->type == PARAM_REF) &&
+                (ptr->res.kind != O_TEMP || ptr->res.id))
+                ptr->opnds[0].id->i_ssa = false;
+            for (i = 0; i < ptr->nopnds; i++)
+                if (!ptr->opnds[i].id && ptr->opnds[i].kind == O_TEMP &&
+                    (var = tempvar[ptr->opnds[i].num - tempbase]) &&
+                    ((ptr->type != LOAD && ptr->type != STORE) || i != 0))
+                    var->i_ssa = false;
+        }
+    for (n = 0; n < (int) tempvar.size(); n++)
+        if (tempvar[n] && ndefs[n] > 1)
+            tempvar[n]->i_ssa = false;
+
+    curdef.assign(gcfg.nblocks, DenseMap<struct id_entry *, Value *>());
+    incomplete.assign(gcfg.nblocks, {});
+    unfilled.resize(gcfg.nblocks);
+    for (i = 0; i < (int) gcfg.nblocks; i++)
+        unfilled[i] = gcfg.predoff[i + 1] - gcfg.predoff[i];
+    pending.clear();
+    phis.clear();
+}
+
+/*
+ * ssavar - the variable an address operand refers to, if it lives in SSA
+ *          values
+ */
+static struct id_entry *ssavar(struct operand *o) {
+    struct id_entry *var;
+
+    if (o->id)
+        return (struct id_entry *) NULL;
+    var = tempvar[o->num - tempbase];
+    return var && var->i_ssa ? var : (struct id_entry *) NULL;
+}
+
+/*
+ * llvmblock - the llvm block generated for a block of the cfg
+ */
+static BasicBlock *llvmblock(unsigned b) {
+    struct bblk *blk = gcfg.blocks[b];
+
+    return blk->lbl ? blk->lbl->v.b : blk->lbblk;
+}
+
+static PHINode *newphi(struct id_entry *var, unsigned b) {
+    PHINode *phi = PHINode::Create(var->u.ltype, 0, var->i_name);
+
+    llvmblock(b)->getInstList().push_front(phi);
+    phis.push_back(phi);
+    return phi;
+}
+
+static void writevar(struct id_entry *var, unsigned b, Value *val) {
+    curdef[b][var] = val;
+}
+
+/*
+ * findvar - the value of a variable at the end of block b, or at the
+ *           current point if b is being generated; a chain of blocks with
+ *           one generated predecessor each is followed without recursion,
+ *           and a phi placed at a join goes on the pending list to get its
+ *           operands
+ */
+static Value *findvar(struct id_entry *var, unsigned b) {
+    SmallVector<unsigned, 8> chain;
+    Value *val;
+    PHINode *phi;
+    unsigned npreds;
+
+    for (;;) {
+        auto it = curdef[b].find(var);
+        if (it != curdef[b].end()) {
+            val = it->second;
+            break;
+        }
+        npreds = gcfg.predoff[b + 1] - gcfg.predoff[b];
+        if (unfilled[b] == 0 && npreds == 1 && chain.size() < gcfg.nblocks) {
+            chain.push_back(b);
+            b = gcfg.pred[gcfg.predoff[b]];
+            continue;
+        }
+        if (unfilled[b] > 0) {
+            /* operands come when the block is sealed */
+            phi = newphi(var, b);
+            incomplete[b].push_back({var, phi, b});
+            val = phi;
+        } else if (npreds == 0 || npreds == 1) {
+            /* never assigned, or an unreachable cycle */
+            val = UndefValue::get(var->u.ltype);
+        } else {
+            phi = newphi(var, b);
+            pending.push_back({var, phi, b});
+            val = phi;
+        }
+        writevar(var, b, val);
+        break;
+    }
+    for (unsigned c : chain)
+        writevar(var, c, val);
+    return val;
+}
+
+/*
+ * fillphis - give each pending phi the variable's value from each
+ *            predecessor of its block, once per edge; looking those up
+ *            may place more phis, so this runs until the list is empty
+ */
+static void fillphis() {
+    struct varphi p;
+    BasicBlock *pb;
+    Value *val;
+    unsigned i;
+
+    while (!pending.empty()) {
+        p = pending.back();
+        pending.pop_back();
+        for (i = gcfg.predoff[p.blk]; i < gcfg.predoff[p.blk + 1]; i++) {
+            pb = llvmblock(gcfg.pred[i]);
+            val = findvar(p.var, gcfg.pred[i]);
+            for (BasicBlock *succ : successors(pb))
+                if (succ == p.phi->getParent())
+                    p.phi->addIncoming(val, pb);
+        }
+    }
+}
+
+/*
+ * readvar - the value of a variable at the current point in block b
+ */
+static Value *readvar(struct id_entry *var, unsigned b) {
+    Value *val = findvar(var, b);
+
+    fillphis();
+    return val;
+}
+
+/*
+ * filledblock - note that block b has been generated, sealing the blocks
+ *               it was the last unfilled predecessor of
+ */
+static void filledblock(unsigned b) {
+    unsigned i, s;
+
+    for (i = gcfg.succoff[b]; i < gcfg.succoff[b + 1]; i++) {
+        s = gcfg.succ[i];
+        if (--unfilled[s] == 0) {
+            pending.insert(pending.end(), incomplete[s].begin(),
+                           incomplete[s].end());
+            incomplete[s].clear();
+        }
+    }
+    fillphis();
+}
+
+/*
+ * removetrivialphis - replace each phi whose operands are all one value
+ *                     (or the phi itself) by that value, until none is left
+ */
+static void removetrivialphis() {
+    SmallPtrSet<PHINode *, 32> removed;
+    std::vector<PHINode *> work(phis);
+    PHINode *phi;
+    Value *same;
+    bool trivial;
+
+    while (!work.empty()) {
+        phi = work.back();
+        work.pop_back();
+        if (removed.count(phi))
+            continue;
+        same = nullptr;
+        trivial = true;
+        for (Value *op : phi->incoming_values()) {
+            if (op == same || op == phi)
+                continue;
+            if (same) {
+                trivial = false;
+                break;
+            }
+            same = op;
+        }
+        if (!trivial)
+            continue;
+        if (!same)
+            same = UndefValue::get(phi->getType());
+        for (User *u : phi->users())
+            if (auto *p = dyn_cast<PHINode>(u))
+                if (p != phi)
+                    work.push_back(p);
+        phi->replaceAllUsesWith(same);
+        phi->eraseFromParent();
+        removed.insert(phi);
+    }
+    phis.clear();
+}
+
 static void allocaFormals(struct quadline **ptr, llvm::Function *fn) {
+    // formals come in argument order (see createFunction), so match them
+    // up by position; the argument names may have been discarded
+    auto Arg = fn->arg_begin();
     for (; (*ptr != NULL) && ((*ptr)->type == FORMAL_ALLOC);
-         *ptr = (*ptr)->next) {
-        auto id_ptr = lookup((*ptr)->items[1], PARAM);
-        assert(id_ptr && "local is missing");
+         *ptr = (*ptr)->next, ++Arg) {
+        auto id_ptr = (*ptr)->res.id;
+        assert(Arg != fn->arg_end() && "more formals than arguments");
+        if (id_ptr->i_ssa) {
+            writevar(id_ptr, curblk, &*Arg);
+            continue;
+        }
         //Kaleidoscope addresses the initializer at this point, but we can't do that yet...
         id_ptr->v.v = Builder.CreateAlloca(
                 id_ptr->u.ltype,nullptr, id_ptr->i_name);
-
-        for (auto  &Arg: fn->args()) {
-            auto name = Arg.getName();
-            if (strcmp(name.data(), id_ptr->i_name) == 0) {
-                Builder.CreateStore(&Arg, id_ptr->v.v);
-                break;
-            }
-        }
+        Builder.CreateStore(&*Arg, id_ptr->v.v);
     }
 }
 
 static void allocaLocals(struct quadline **ptr) {
     for (; (*ptr != NULL) && ((*ptr)->type == LOCAL_ALLOC);
          *ptr = (*ptr)->next) {
-        auto id_ptr = lookup((*ptr)->items[1], LOCAL);
-        assert(id_ptr && "local is missing");
+        auto id_ptr = (*ptr)->res.id;
 
         if (id_ptr->i_type & T_ARRAY) {
             if (id_ptr->i_type & T_INT) {
@@ -214,205 +873,174 @@ static void allocaLocals(struct quadline **ptr) {
             id_ptr->v.v = Builder.CreateAlloca(id_ptr->u.ltype,llvm::ConstantInt::get(llvm::Type::getInt32Ty(TheContext), id_ptr->i_numelem), id_ptr->i_name);
         }
         else {
-            if (id_ptr->i_type & T_INT) {
-                id_ptr->v.v = Builder.CreateAlloca(llvm::Type::getInt32Ty(
-                                TheContext), nullptr, id_ptr->i_name);
+            if (id_ptr->i_type & T_INT)
                 id_ptr->u.ltype = Builder.getInt32Ty();
-            } else {
-                id_ptr->v.v = Builder.CreateAlloca(llvm::Type::getDoubleTy(
-                                TheContext), nullptr, id_ptr->i_name);
+            else
                 id_ptr->u.ltype = Builder.getDoubleTy();
-            }
+            if (!id_ptr->i_ssa)
+                id_ptr->v.v = Builder.CreateAlloca(id_ptr->u.ltype, nullptr,
+                                                   id_ptr->i_name);
         }
     }
 }
 
+/*
+ * settemps - make room in the register file for every temporary the
+ *            current function defines
+ */
+static void settemps() {
+    struct bblk *blk;
+    struct quadline *ptr;
+    int lo = INT_MAX, hi = -1;
+    extern thread_local struct bblk *top;
+
+    for (blk = top; blk; blk = blk->down)
+        for (ptr = blk->lines; ptr; ptr = ptr->next)
+            if (ptr->res.kind == O_TEMP) {
+                lo = std::min(lo, ptr->res.num);
+                hi = std::max(hi, ptr->res.num);
+            }
+    tempbase = lo;
+    temps.assign(hi >= lo ? hi - lo + 1 : 0, nullptr);
+}
+
+/*
+ * getvalue - the value of an operand; temporaries come from the register
+ *            file, anything else from the symbol it is bound to
+ */
+static Value *getvalue(struct operand *o) {
+    struct id_entry *id_ptr = o->id;
+
+    if (!id_ptr)
+        return temps[o->num - tempbase];
+    if (id_ptr->i_scope == GLOBAL && id_ptr->gvar)
+        return id_ptr->gvar;
+    return id_ptr->v.v;
+}
+
+/*
+ * setvalue - give the result of a quad its value
+ */
+static void setvalue(struct operand *o, Value *val) {
+    if (!o->id)
+        temps[o->num - tempbase] = val;
+    else
+        o->id->v.v = val;
+}
+
 /*
  *  Create constant (int) value
  */
 void createAssign(struct quadline *ptr) {
-    struct id_entry *id_ptr;
-    int val = atoi(ptr->items[2]);
-    id_ptr = install(ptr->items[0], LOCAL);
-    id_ptr->v.v = llvm::ConstantInt::get(llvm::Type::getInt32Ty(TheContext), val);
+    setvalue(&ptr->res, llvm::ConstantInt::get(
+            llvm::Type::getInt32Ty(TheContext), ptr->opnds[0].num));
 }
 
 void createLoad(struct quadline *ptr) {
-    auto loadAddr = lookup(ptr->items[3], LOCAL);
-    auto loadVal = install(ptr->items[0], LOCAL);
-    assert(loadAddr && loadVal && "Load instruction generation fails");
-    loadVal->v.v = Builder.CreateLoad(loadAddr->v.v,ptr->items[0]);
+    struct id_entry *var;
+
+    if ((var = ssavar(&ptr->opnds[0]))) {
+        setvalue(&ptr->res, readvar(var, curblk));
+        return;
+    }
+    auto loadAddr = getvalue(&ptr->opnds[0]);
+    assert(loadAddr && "Load instruction generation fails");
+    setvalue(&ptr->res, Builder.CreateLoad(loadAddr, ptr->res.name));
 }
 
 void createStore(struct quadline *ptr) {
-    struct id_entry *lhs, *rhs, *res;
+    Value *lhs, *rhs;
+    struct id_entry *var;
 
-    rhs = lookup(ptr->items[4], LOCAL);
-    lhs = lookup(ptr->items[2], LOCAL);
-    Builder.CreateStore(rhs->v.v, lhs->v.v);
-
-    res = install(ptr->items[0], LOCAL);
-    res->v.v = rhs->v.v;
+    rhs = getvalue(&ptr->opnds[1]);
+    if ((var = ssavar(&ptr->opnds[0])))
+        writevar(var, curblk, rhs);
+    else {
+        lhs = getvalue(&ptr->opnds[0]);
+        Builder.CreateStore(rhs, lhs);
+    }
+    setvalue(&ptr->res, rhs);
 }
 
 void createRef(struct quadline *ptr, int scope) {
-    struct id_entry *refVar, *refAddr;
-
-    refVar = lookup(ptr->items[3], scope);
-    refAddr = install(ptr->items[0], scope);
-    refAddr->v.v = refVar->v.v;
-    if (scope == GLOBAL) {
-        refAddr->gvar = refVar->gvar;
-        refAddr->i_scope = GLOBAL;
-    }
+    struct id_entry *refVar;
+
+    refVar = ptr->opnds[0].id;
+    if (ssavar(&ptr->res))
+        return; // loads and stores through it use the variable's values
+    if (scope == GLOBAL && refVar->gvar)
+        setvalue(&ptr->res, refVar->gvar);
+    else
+        setvalue(&ptr->res, refVar->v.v);
 }
 
 void createReturn(struct quadline *ptr) {
-    struct id_entry *id_ptr;
-
-    id_ptr = lookup(ptr->items[1], LOCAL);
-    Builder.CreateRet(id_ptr->v.v);
+    Builder.CreateRet(getvalue(&ptr->opnds[0]));
 }
 
+/*
+ * the instruction for each arithmetic operator and the predicate for each
+ * comparison, on ints and on doubles; the bitwise operators and shifts
+ * are decoded for ints only
+ */
+static constexpr Instruction::BinaryOps arithops[][2] = {
+        {Instruction::Add, Instruction::FAdd},   /* ADD */
+        {Instruction::Sub, Instruction::FSub},   /* SUB */
+        {Instruction::Mul, Instruction::FMul},   /* MUL */
+        {Instruction::SDiv, Instruction::FDiv},  /* DIV */
+        {Instruction::SRem, Instruction::FRem},  /* MOD */
+        {Instruction::Shl, Instruction::Shl},    /* LSHIFT */
+        {Instruction::LShr, Instruction::LShr},  /* RSHIFT */
+        {Instruction::And, Instruction::And},    /* AND */
+        {Instruction::Or, Instruction::Or},      /* OR */
+};
+static constexpr CmpInst::Predicate relops[][2] = {
+        {CmpInst::ICMP_EQ, CmpInst::FCMP_OEQ},   /* EQ */
+        {CmpInst::ICMP_NE, CmpInst::FCMP_ONE},   /* NE */
+        {CmpInst::ICMP_SLT, CmpInst::FCMP_OLT},  /* LT */
+        {CmpInst::ICMP_SGT, CmpInst::FCMP_OGT},  /* GT */
+        {CmpInst::ICMP_SLE, CmpInst::FCMP_OLE},  /* LE */
+        {CmpInst::ICMP_SGE, CmpInst::FCMP_OGE},  /* GE */
+};
+static_assert(sizeof(arithops) / sizeof(arithops[0]) == NONE_AR,
+              "arithops must cover arithematic_type");
+static_assert(sizeof(relops) / sizeof(relops[0]) == NONE_RE,
+              "relops must cover relational_type");
+
 void createBinOp(struct quadline *ptr) {
-    struct id_entry *op1, *op2, *res;
-    llvm::Value *resultVal;
-    char op     [strlen(ptr->items[3])];
-    char op_type[strlen(ptr->items[3])];
-    char *resultName;
-
-    op1 = lookup(ptr->items[2], LOCAL);
-    op2 = lookup(ptr->items[4], LOCAL);
-
-    // parse '<operator><operator_type>' from quadline
-    strncpy(op, ptr->items[3], strlen(ptr->items[3])-1);
-    op[strlen(ptr->items[3])-1] = '\0';
-    op_type[0] = ptr->items[3][strlen(ptr->items[3])-1];
-    op_type[1] = '\0';
-
-    switch(*op) {
-        case '+':
-            if (op_type[0] == 'i')
-                resultVal = Builder.CreateAdd(op1->v.v, op2->v.v);
-            else// op_type == 'f'
-                resultVal = Builder.CreateFAdd(op1->v.v, op2->v.v);
-            break;
-        case '-':
-            if (op_type[0] == 'i')
-                resultVal = Builder.CreateSub(op1->v.v, op2->v.v);
-            else// op_type == 'f'
-                resultVal = Builder.CreateFSub(op1->v.v, op2->v.v);
-            break;
-        case '*':
-            if (op_type[0] == 'i')
-                resultVal = Builder.CreateMul(op1->v.v, op2->v.v);
-            else// op_type == 'f'
-                resultVal = Builder.CreateFMul(op1->v.v, op2->v.v);
-            break;
-        case '/':
-            if (op_type[0] == 'i')
-                resultVal = Builder.CreateSDiv(op1->v.v, op2->v.v);
-            else// op_type == 'f'
-                resultVal = Builder.CreateFDiv(op1->v.v, op2->v.v);
-            break;
-        case '%':
-            if (op_type[0] == 'i')
-                resultVal = Builder.CreateSRem(op1->v.v, op2->v.v);
-            else
-                resultVal = Builder.CreateFRem(op1->v.v, op2->v.v);
-            break;
-        case '|':
-            resultVal = Builder.CreateOr(op1->v.v, op2->v.v);
-            break;
-        case '&':
-            resultVal = Builder.CreateAnd(op1->v.v, op2->v.v);
-            break;
-        case '=': // ==
-            if (op_type[0] == 'i')
-                resultVal = Builder.CreateICmpEQ(op1->v.v, op2->v.v);
-            else
-                resultVal = Builder.CreateFCmpOEQ(op1->v.v, op2->v.v);
-            break;
-        case '!': // !=
-            if (op_type[0] == 'i')
-                resultVal = Builder.CreateICmpNE(op1->v.v, op2->v.v);
-            else
-                resultVal = Builder.CreateFCmpONE(op1->v.v, op2->v.v);
-            break;
-        case '>':
-            if (op[1] == '>') // '>>'
-                resultVal = Builder.CreateLShr(op1->v.v, op2->v.v);
-            else if (op[1] == '=') { // '>='
-                if (op_type[0] == 'i')
-                    resultVal = Builder.CreateICmpSGE(op1->v.v, op2->v.v);
-                else
-                    resultVal = Builder.CreateFCmpOGE(op1->v.v, op2->v.v);
-            }
-            else { // '>'
-                if (op_type[0] == 'i')
-                    resultVal = Builder.CreateICmpSGT(op1->v.v, op2->v.v);
-                else
-                    resultVal = Builder.CreateFCmpOGT(op1->v.v, op2->v.v);
-            }
-            break;
-        case '<':
-            if (op[1] == '<') // '<<'
-                resultVal = Builder.CreateShl(op1->v.v, op2->v.v);
-            else if (op[1] == '=') {
-                if (op_type[0] == 'i') // '<='
-                    resultVal = Builder.CreateICmpSLE(op1->v.v, op2->v.v);
-                else
-                    resultVal = Builder.CreateFCmpOLE(op1->v.v, op2->v.v);
-            }
-            else { // '<'
-                if (op_type[0] == 'i')
-                    resultVal = Builder.CreateICmpSLT(op1->v.v, op2->v.v);
-                else
-                    resultVal = Builder.CreateFCmpOLT(op1->v.v, op2->v.v);
-            }
-            break;
-        default:
-            break;
-    }
-    res = install(ptr->items[0], LOCAL);
-    res->v.v = resultVal;
+    Value *op1, *op2, *resultVal;
+    bool isdouble = ptr->optype == T_DOUBLE;
+
+    op1 = getvalue(&ptr->opnds[0]);
+    op2 = getvalue(&ptr->opnds[1]);
+    if (ptr->rel != NONE_RE)
+        resultVal = Builder.CreateCmp(relops[ptr->rel][isdouble], op1, op2);
+    else
+        resultVal = Builder.CreateBinOp(arithops[ptr->arith][isdouble], op1,
+                                        op2);
+    setvalue(&ptr->res, resultVal);
 }
 
 void createAddrArrayIndx(struct quadline *ptr) {
-    struct id_entry *arrayaddr, *arraybase, *arrayidx;
+    Value *arraybase, *arrayidx;
 
-    arraybase = lookup(ptr->items[2], LOCAL);
-    arrayidx = lookup(ptr->items[4], LOCAL);
-
-    arrayaddr = install(ptr->items[0], LOCAL);
-    if (arraybase->i_scope == GLOBAL)
-        arrayaddr->v.v = Builder.CreateInBoundsGEP(arraybase->gvar, std::vector<Value*>{ConstantInt::get(Type::getInt32Ty(TheContext), 0), arrayidx->v.v});
-    else
-        arrayaddr->v.v = Builder.CreateInBoundsGEP(arraybase->v.v, std::vector<Value*>{ConstantInt::get(Type::getInt32Ty(TheContext), 0), arrayidx->v.v});
+    arraybase = getvalue(&ptr->opnds[0]);
+    arrayidx = getvalue(&ptr->opnds[1]);
+    setvalue(&ptr->res, Builder.CreateInBoundsGEP(arraybase, std::vector<Value*>{ConstantInt::get(Type::getInt32Ty(TheContext), 0), arrayidx}));
 }
 
 void createIntConversion(struct quadline *ptr) {
-    struct id_entry *casting, *casted;
-
-    casting = lookup(ptr->items[3], LOCAL);
-    casted = install(ptr->items[0], LOCAL);
-    casted->v.v = Builder.CreateFPToSI(casting->v.v, llvm::Type::getInt32Ty(TheContext));
+    Value *casting = getvalue(&ptr->opnds[0]);
+    setvalue(&ptr->res, Builder.CreateFPToSI(casting, llvm::Type::getInt32Ty(TheContext)));
 }
 
 void createFPConversion(struct quadline *ptr) {
-    struct id_entry *casting, *casted;
-
-    casting = lookup(ptr->items[3], LOCAL);
-    casted = install(ptr->items[0], LOCAL);
-    casted->v.v = Builder.CreateSIToFP(casting->v.v, llvm::Type::getDoubleTy(TheContext));
+    Value *casting = getvalue(&ptr->opnds[0]);
+    setvalue(&ptr->res, Builder.CreateSIToFP(casting, llvm::Type::getDoubleTy(TheContext)));
 }
 
 void createString(struct quadline *ptr) {
-    struct id_entry *id_ptr;
-
-    id_ptr = install(ptr->items[0], LOCAL);
-
-    std::string str = ptr->items[2];
+    std::string str = ptr->opnds[0].name;
 
     // formatting so that string will print properly (escaped seqs are recognized) in shell
     str = std::regex_replace(str,std::regex("\\\\r"),"\r");
@@ -422,100 +1050,72 @@ void createString(struct quadline *ptr) {
     str = std::regex_replace(str,std::regex("\\\\\""),"\"");
 
     // create global string POINTER since printf will expect this
-    //id_ptr->v.v = Builder.CreateGlobalStringPtr(llvm::StringRef(ptr->items[2]));
-    id_ptr->v.v = Builder.CreateGlobalStringPtr(llvm::StringRef(str));
+    //id_ptr->v.v = Builder.CreateGlobalStringPtr(llvm::StringRef(ptr->opnds[0].name));
+    setvalue(&ptr->res, Builder.CreateGlobalStringPtr(llvm::StringRef(str)));
 }
 
 void createFuncCall(struct quadline *ptr) {
-    struct id_entry *f, *id_ptr;
+    llvm::Function *f;
     llvm::Value *retval;
     llvm::SmallVector<Value *, 4> args;
 
     // find function we want to call
-    f = lookup(ptr->items[3], GLOBAL);
-
-    // check if there are args and get them
-    if (ptr->numitems > 4) {
-        // get the arguments
-        int numargs = atoi(ptr->items[4]);
-        for (int i = 0; i < numargs; ++i) {
-            id_ptr = lookup(ptr->items[5 + i], LOCAL);
-            args.push_back(id_ptr->v.v);
-        }
-        // call the function
-        retval = Builder.CreateCall(f->v.f, args);
-    }
-    else
-        // call function with no args
-        retval = Builder.CreateCall(f->v.f);
+    f = llvm::cast<Function>(getvalue(&ptr->opnds[0]));
 
-    // install result to symbol table
-    id_ptr = install(ptr->items[0], LOCAL);
-    id_ptr->v.v = retval;
+    // get the arguments and call the function
+    for (int i = 1; i < ptr->nopnds; ++i)
+        args.push_back(getvalue(&ptr->opnds[i]));
+    retval = Builder.CreateCall(f, args);
+
+    // the result goes to the register file
+    setvalue(&ptr->res, retval);
 }
 
 void createUnaryOp(struct quadline *ptr) {
-    struct id_entry *oper, *res;
-
-    oper = lookup(ptr->items[3], LOCAL);
-    res = install(ptr->items[0], LOCAL);
-
-    char op = ptr->items[2][0];
-    char op_type = ptr->items[2][1];
+    Value *oper;
 
-    switch (op) {
-        case '-':
-            if (op_type == 'i')
-                res->v.v = Builder.CreateNeg(oper->v.v);
-            else// == 'f'
-                res->v.v = Builder.CreateFNeg(oper->v.v);
-            break;
-        case '~':
-            res->v.v = Builder.CreateNot(oper->v.v);
-            break;
-        default:
-            break;
-    }
+    // negation is the only unary operator
+    oper = getvalue(&ptr->opnds[0]);
+    if (ptr->optype == T_INT)
+        setvalue(&ptr->res, Builder.CreateNeg(oper));
+    else
+        setvalue(&ptr->res, Builder.CreateFNeg(oper));
 }
-extern struct bblk *findtarget(char *label);
 
 void createBranch(struct quadline *ptr) {
-    struct id_entry *cond, *tb, *fb;
+    struct id_entry *tb, *fb;
+    Value *cond;
     struct quadline *fallthrough;
-    struct bblk *trueblk, *falseblk;
 
     llvm::Function *TheFunction = Builder.GetInsertBlock()->getParent();
 
-    cond = lookup(ptr->items[1], LOCAL);
-    trueblk = findtarget(ptr->items[2]);
-    tb = lookup(ptr->items[2], LOCAL);
+    cond = getvalue(&ptr->opnds[0]);
+    tb = ptr->opnds[1].id;
 
     // look for next inst, which should be a 'br' inst, to find false block
     fallthrough = ptr->next;
-    falseblk = findtarget(fallthrough->items[1]);
-    fb = lookup(fallthrough->items[1], LOCAL);
+    fb = fallthrough->opnds[0].id;
 
     llvm::BasicBlock *truebblk, *falsebblk;
 
     if (tb->v.b)
         truebblk = tb->v.b;
     else {
-        truebblk = BasicBlock::Create(TheContext, trueblk->label, TheFunction);
+        truebblk = BasicBlock::Create(TheContext, ptr->opnds[1].name, TheFunction);
         tb->v.b = truebblk;
     }
 
     if (fb->v.b)
         falsebblk = fb->v.b;
     else {
-        falsebblk = BasicBlock::Create(TheContext, falseblk->label, TheFunction);
+        falsebblk = BasicBlock::Create(TheContext, fallthrough->opnds[0].name, TheFunction);
         fb->v.b = falsebblk;
     }
-    Builder.CreateCondBr(cond->v.v, truebblk, falsebblk);
+    Builder.CreateCondBr(cond, truebblk, falsebblk);
 }
 
 void createJump(struct quadline *ptr) {
     struct id_entry *target;
-    struct bblk *tblk;
 
     // don't emit code if there was a preceding 'bt' or 'ret' quad
     if (ptr->prev != nullptr)
@@ -524,14 +1124,13 @@ void createJump(struct quadline *ptr) {
 
     llvm::Function *TheFunction = Builder.GetInsertBlock()->getParent();
 
-    target = lookup(ptr->items[1], LOCAL);
-    tblk = findtarget(ptr->items[1]);
+    target = ptr->opnds[0].id;
 
     llvm::BasicBlock *ltblk;
     if (target->v.b)
         ltblk = target->v.b;
     else {
-        ltblk = BasicBlock::Create(TheContext, tblk->label, TheFunction);
+        ltblk = BasicBlock::Create(TheContext, ptr->opnds[0].name, TheFunction);
         target->v.b = ltblk;
     }
     Builder.CreateBr(ltblk);
@@ -601,20 +1200,20 @@ void bitcodegen() {
     struct bblk *blk;
     struct quadline *ptr;
     struct id_entry *iptr;
-    extern struct bblk *top;
+    extern thread_local struct bblk *top;
 
     // any global, then define
     for (ptr = top->lines; ptr && ptr->type == GLOBAL_ALLOC; ptr=ptr->next) {
-        iptr = lookup(ptr->items[1],GLOBAL);
-        assert(iptr && "global is not defined");
+        iptr = ptr->res.id;
         createGlobal(iptr);
     }
 
     // generate function signature
     assert(ptr && (ptr->type == FUNC_BEGIN) && "Function definition is expected");
-    auto fn = lookup(ptr->items[1], GLOBAL);
-    assert(fn && "function name is not present");
+    auto fn = ptr->res.id;
     createFunction(fn, &ptr);
+    settemps();
+    findssavars();
 
     BasicBlock *BB = BasicBlock::Create(TheContext, "entry", fn->v.f);
     top->lbblk = BB;
@@ -624,13 +1223,14 @@ void bitcodegen() {
     // allocate storage for locals
     // generate bitcode for globals, function header, params, and locals
     for (; ptr->prev && ptr->prev->type == FORMAL_ALLOC; ptr=ptr->prev);
+    curblk = top->num;
     allocaFormals(&ptr, fn->v.f);
     allocaLocals(&ptr);
     createBitcode(ptr,fn);
 
     // check if br inst needs to be inserted at end of top block
     if (top->lineend->type != JUMP && top->lineend->type != RETURN && top->down != nullptr) {
-        auto succ = lookup(top->down->label, LOCAL);
+        auto succ = top->down->lbl;
         // add bitcode to the down basic bl
         llvm::BasicBlock *ltblk;
         if (succ->v.b)
@@ -641,20 +1241,24 @@ void bitcodegen() {
         }
         Builder.CreateBr(ltblk);
     }
+    filledblock(top->num);
 
     for (auto bblk = top->down; bblk ; bblk=bblk->down) {
-        auto bb = lookup(bblk->label, LOCAL);
+        auto bb = bblk->lbl;
 
         // if 'fend' is the only instruction in the block, skip it
-        if (bblk->lines == bblk->lineend && strcmp(bblk->lines->text, "fend") == 0)
+        if (bblk->lines == bblk->lineend && bblk->lines->type == FUNC_END) {
+            filledblock(bblk->num);
             continue;
+        }
 
         if (bb->v.b == nullptr)
             bb->v.b = BasicBlock::Create(TheContext, bblk->label, fn->v.f);
         Builder.SetInsertPoint(bb->v.b);
+        curblk = bblk->num;
         createBitcode(bblk->lines, fn);
         if (bblk->lineend->type != JUMP && bblk->lineend->type != RETURN && bblk->down != nullptr) {
-            auto succ = lookup(bblk->down->label, LOCAL);
+            auto succ = bblk->down->lbl;
             // add bitcode to the down basic bl
             llvm::BasicBlock *ltblk;
             if (succ->v.b)
@@ -665,6 +1269,10 @@ void bitcodegen() {
             }
             Builder.CreateBr(ltblk);
         }
+        filledblock(bblk->num);
     }
+    removetrivialphis();
+    if (streaming)
+        StreamFunction();
     return;
 }
@@ -5,8 +5,25 @@
 #ifndef QUADREADER_BITCODEGEN_H
 #define QUADREADER_BITCODEGEN_H
 
+#include <cstdint>
+
+/* what the module is written as */
+enum outformat {
+    OUT_TEXT,    /* textual IR */
+    OUT_BITCODE, /* bitcode */
+    OUT_OBJECT,  /* relocatable object file */
+    OUT_ASM,     /* assembly */
+    OUT_EXE      /* executable, linked by the system C compiler */
+};
+
 void InitializeModuleAndPassManager();
-void OutputModule();
+bool OpenOutput(const char *, enum outformat, bool);
+uint64_t OutputModule();
+int RunModule(double *, double *);
+void StreamModule();
+void DiscardValueNames();
+bool SetOptLevel(const char *);
+double OptimizeModule();
 void bitcodegen();
 
 #endif //QUADREADER_BITCODEGEN_H
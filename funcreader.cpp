@@ -0,0 +1,263 @@
+/*
+ * parallel function reader
+ *
+ * The whole input is scanned once for function boundaries: a region runs
+ * from the end of the previous function through the fend line of the next
+ * one, so global allocs between two functions travel with the function that
+ * follows them, exactly as in readinfunc().  A pool of workers then reads,
+ * backpatches and sets up the control flow of the regions independently;
+ * each worker has its own top/bot/gbp and arena, and every function read
+ * takes its arena along to code generation.  Symbols are only installed by the
+ * code generator, so workers never touch the symbol table.
+ *
+ * The pipelined reader instead runs a single thread that reads the input as
+ * it arrives, the way the sequential loop does, and queues each function
+ * it has finished for code generation.  At most depth functions wait in the
+ * queue, which bounds the memory held by functions read ahead.
+ */
+#include "funcreader.h"
+#include "misc.h"
+#include "quadreader.h"
+#include "quadscan.h"
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+extern thread_local struct bblk *top, *bot;
+extern thread_local struct bplist *gbp;
+extern thread_local struct cfg gcfg;
+extern thread_local struct arena *farena;
+
+/* the input lines of one function */
+struct region {
+    char *begin; /* first byte of the region */
+    char *end;   /* one past its last byte */
+    int lineno;  /* number of the line before begin */
+};
+
+struct funcreader {
+    std::vector<struct region> regions;
+    std::vector<struct qfunc> funcs; /* functions read, by region */
+    std::vector<bool> done;          /* funcs[i] has been read */
+    size_t claimed;                  /* regions taken by workers */
+    size_t next;                     /* next region to hand out */
+    size_t window;                   /* regions that may be read ahead */
+    std::mutex lock;
+    std::condition_variable ready;   /* a region has been read */
+    std::condition_variable space;   /* a region has been handed out */
+    std::vector<std::thread> workers;
+
+    /* pipelined reader */
+    struct quadbuf *qb;              /* input read by the thread, or NULL */
+    std::deque<struct qfunc> queue;  /* functions waiting for codegen */
+    size_t depth;                    /* most functions that may wait */
+    bool eof;                        /* the thread has read everything */
+    bool stop;                       /* the thread should stop reading */
+};
+
+/*
+ * firstitem - check whether the first item of the line [p, nl) is kw
+ */
+static bool firstitem(const char *p, const char *nl, const char *kw) {
+    size_t n = strlen(kw);
+
+    while (p < nl && (*p == ' ' || *p == '\t'))
+        p++;
+    if ((size_t) (nl - p) < n || strncmp(p, kw, n) != 0)
+        return false;
+    p += n;
+    return p == nl || *p == ' ' || *p == '\t';
+}
+
+/*
+ * splitfuncs - cut the rest of the input into function regions
+ */
+static void splitfuncs(struct quadbuf *qb, std::vector<struct region> &regions) {
+    char *p, *nl, *begin = qb->cur, *end = qb->end;
+    int lineno = qb->lineno, start = lineno;
+    bool infunc = false;
+
+    for (p = begin; p < end; p = nl + 1) {
+        if (!(nl = findnewline(p, end)))
+            nl = end;
+        lineno++;
+        if (!infunc)
+            infunc = firstitem(p, nl, "func");
+        else if (firstitem(p, nl, "fend")) {
+            regions.push_back({begin, nl < end ? nl + 1 : end, start});
+            begin = nl < end ? nl + 1 : end;
+            start = lineno;
+            infunc = false;
+        }
+    }
+    if (begin < end)
+        regions.push_back({begin, end, start});
+    qb->bytes += end - qb->cur;
+    qb->cur = end;
+    qb->lineno = lineno;
+}
+
+/*
+ * parseworker - read regions until there are none left
+ */
+static void parseworker(struct funcreader *fr) {
+    struct quadbuf sub;
+    struct qfunc f;
+    size_t i;
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lk(fr->lock);
+            fr->space.wait(lk, [fr] {
+                return fr->claimed < fr->next + fr->window;
+            });
+            if (fr->claimed == fr->regions.size())
+                return;
+            i = fr->claimed++;
+        }
+
+        openquadrange(&sub, fr->regions[i].begin, fr->regions[i].end,
+                      fr->regions[i].lineno);
+        f.top = f.bot = (struct bblk *) NULL;
+        f.bp = gbp = (struct bplist *) NULL;
+        f.arena = (struct arena *) NULL;
+        memset(&f.cfg, 0, sizeof(f.cfg));
+        if (readinfunc(&sub)) {
+            backpatching();
+            setupcontrolflow();
+            f.top = top;
+            f.bot = bot;
+            f.bp = gbp;
+            f.cfg = gcfg;
+            f.arena = farena;
+            farena = (struct arena *) NULL;
+        } else
+            free_func_structs();
+
+        {
+            std::lock_guard<std::mutex> lk(fr->lock);
+            fr->funcs[i] = f;
+            fr->done[i] = true;
+        }
+        fr->ready.notify_all();
+    }
+}
+
+/*
+ * pipeworker - read functions in order and queue them until the input ends
+ */
+static void pipeworker(struct funcreader *fr) {
+    struct qfunc f;
+    bool more;
+
+    do {
+        gbp = (struct bplist *) NULL;
+        if ((more = readinfunc(fr->qb))) {
+            backpatching();
+            setupcontrolflow();
+            f.top = top;
+            f.bot = bot;
+            f.bp = gbp;
+            f.cfg = gcfg;
+            f.arena = farena;
+            farena = (struct arena *) NULL;
+        } else
+            free_func_structs();
+
+        {
+            std::unique_lock<std::mutex> lk(fr->lock);
+            if (more) {
+                fr->space.wait(lk, [fr] {
+                    return fr->queue.size() < fr->depth || fr->stop;
+                });
+                if (fr->stop)
+                    more = false;
+                else
+                    fr->queue.push_back(f);
+            }
+            if (!more)
+                fr->eof = true;
+        }
+        fr->ready.notify_all();
+    } while (more);
+}
+
+/*
+ * startparallelreader - read the functions in qb on nthreads workers, with
+ *                       at most depth of them read ahead of codegen (0 for
+ *                       the default)
+ */
+struct funcreader *startparallelreader(struct quadbuf *qb, int nthreads,
+                                       int depth) {
+    struct funcreader *fr = new funcreader;
+    int i;
+
+    loadquadbuf(qb);
+    splitfuncs(qb, fr->regions);
+    fr->funcs.resize(fr->regions.size());
+    fr->done.assign(fr->regions.size(), false);
+    fr->claimed = fr->next = 0;
+    fr->window = depth > 0 ? depth : (size_t) nthreads * PARSEAHEAD;
+    fr->qb = (struct quadbuf *) NULL;
+    for (i = 0; i < nthreads; i++)
+        fr->workers.emplace_back(parseworker, fr);
+    return fr;
+}
+
+/*
+ * startpipelinedreader - read the functions in qb on one thread, queueing
+ *                        up to depth of them for codegen
+ */
+struct funcreader *startpipelinedreader(struct quadbuf *qb, int depth) {
+    struct funcreader *fr = new funcreader;
+
+    fr->claimed = fr->next = fr->window = 0;
+    fr->qb = qb;
+    fr->depth = depth > 0 ? depth : 1;
+    fr->eof = fr->stop = false;
+    fr->workers.emplace_back(pipeworker, fr);
+    return fr;
+}
+
+/*
+ * nextfunc - wait for the next function in input order; false at the end
+ */
+bool nextfunc(struct funcreader *fr, struct qfunc *f) {
+    std::unique_lock<std::mutex> lk(fr->lock);
+
+    if (fr->qb) {
+        fr->ready.wait(lk, [fr] { return !fr->queue.empty() || fr->eof; });
+        if (fr->queue.empty())
+            return false;
+        *f = fr->queue.front();
+        fr->queue.pop_front();
+        fr->space.notify_all();
+        return true;
+    }
+    while (fr->next < fr->regions.size()) {
+        fr->ready.wait(lk, [fr] { return fr->done[fr->next]; });
+        *f = fr->funcs[fr->next++];
+        fr->space.notify_all();
+        if (f->top)
+            return true;
+    }
+    return false;
+}
+
+/*
+ * stopreader - wait for the workers and release the reader
+ */
+void stopreader(struct funcreader *fr) {
+    {
+        std::lock_guard<std::mutex> lk(fr->lock);
+        fr->next = fr->claimed = fr->regions.size();
+        fr->stop = true;
+    }
+    fr->space.notify_all();
+    for (auto &w : fr->workers)
+        w.join();
+    delete fr;
+}
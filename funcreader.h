@@ -0,0 +1,22 @@
+//
+// function reader - reads functions on background threads and hands them to
+// code generation in input order, either split up among a pool of workers or
+// pipelined through a bounded queue by a single reader
+//
+
+#ifndef QUADREADER_FUNCREADER_H
+#define QUADREADER_FUNCREADER_H
+
+#include "quad.h"
+#include "quadinput.h"
+
+#define PARSEAHEAD 8 /* functions each worker may parse ahead of codegen */
+
+struct funcreader;
+
+struct funcreader *startparallelreader(struct quadbuf *, int, int);
+struct funcreader *startpipelinedreader(struct quadbuf *, int);
+bool nextfunc(struct funcreader *, struct qfunc *);
+void stopreader(struct funcreader *);
+
+#endif //QUADREADER_FUNCREADER_H
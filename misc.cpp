@@ -8,10 +8,13 @@
 #define MAXLINE 81
 
 #include "misc.h"
+#include "arena.h"
+#include "atom.h"
 #include "quad.h"
 #include <cctype>
 #include <csetjmp>
 #include <cstring>
+#include <ctime>
 
 /*
  * alloc - allocates space and checks the status of the allocation
@@ -29,13 +32,25 @@ void *alloc(unsigned int bytes) {
 }
 
 /*
- * allocstring - allocate space for a string and copy the string to that
- *               location
+ * falloc - allocate space that lives as long as the function being read; it
+ *          is all given back at once by free_func_structs()
+ */
+void *falloc(unsigned int bytes) {
+    extern thread_local struct arena *farena;
+
+    if (!farena)
+        farena = newarena();
+    return aralloc(farena, bytes);
+}
+
+/*
+ * allocstring - allocate space for a string of the current function and copy
+ *               the string to that location
  */
 char *allocstring(char *str) {
     char *dst;
 
-    dst = (char *) alloc(strlen(str) + 1);
+    dst = (char *) falloc(strlen(str) + 1);
     strcpy(dst, str);
     return dst;
 }
@@ -60,10 +75,8 @@ void replacestring(char **s1, char *old, char *news) {
             ;
         if (strlen(old) >= strlen(news))
             strcpy(*s1, t);
-        else {
-            free(*s1);
+        else
             *s1 = allocstring(t);
-        }
         return;
     }
     fprintf(stderr, "replacestring - dst string not yet allocated\n");
@@ -77,16 +90,47 @@ int isconst(char *s) {
     return isdigit((int) *s) || (*s == '-' && isdigit((int) *(s + 1)));
 }
 
+/*
+ * Each reader thread indexes the labels and the backpatch pairs of the
+ * function it is reading by interned name.
+ */
+static thread_local struct atommap labels; /* label -> block it starts */
+static thread_local struct atommap pairs;  /* Bn -> its backpatch pair */
+static thread_local struct bblk *blkslab;  /* room for new blocks */
+static thread_local unsigned blkleft;      /* blocks left in blkslab */
+
+/*
+ * startfunc - reset the state of the reading thread for the next function:
+ *             empty the label and backpatch indexes and start a new slab
+ *             of blocks
+ */
+void startfunc() {
+    amreset(&labels);
+    amreset(&pairs);
+    blkleft = 0;
+}
+
+/*
+ * findtarget - return the block that label starts in the function being
+ *              read, or NULL
+ */
+struct bblk *findtarget(char *label) {
+    void **vp;
+
+    if (!label || !(vp = amfind(&labels, label)))
+        return (struct bblk *) NULL;
+    return (struct bblk *) *vp;
+}
+
 /*
  * assignlabel - assigns a label to a basic block
  */
 void assignlabel(struct bblk *cblk, char *label) {
-    /* assign label */
-    if (cblk->label)
-        free(cblk->label);
-    if (label)
-        cblk->label = allocstring(label);
-    else
+    /* assign label; the first block with a label is the one branches reach */
+    if (label) {
+        cblk->label = internstr(label);
+        amadd(&labels, cblk->label, cblk);
+    } else
         cblk->label = (char *) NULL;
 }
 
@@ -96,8 +140,14 @@ void assignlabel(struct bblk *cblk, char *label) {
 struct bblk *newblk(char *label) {
     struct bblk *tblk;
 
-    /* allocate the space for the block */
-    tblk = (struct bblk *) alloc(sizeof(struct bblk));
+    /* allocate the space for the block, BLKSLAB at a time so that the
+       blocks of a function lie together */
+    if (!blkleft) {
+        blkslab = (struct bblk *) falloc(BLKSLAB * sizeof(struct bblk));
+        blkleft = BLKSLAB;
+    }
+    tblk = blkslab++;
+    blkleft--;
 
     /* initialize the fields of the block */
     tblk->label = (char *) NULL;
@@ -105,10 +155,9 @@ struct bblk *newblk(char *label) {
     tblk->num = 0;
     tblk->lines = (struct quadline *) NULL;
     tblk->lineend = (struct quadline *) NULL;
-    tblk->preds = (struct blist *) NULL;
-    tblk->succs = (struct blist *) NULL;
     tblk->up = (struct bblk *) NULL;
     tblk->down = (struct bblk *) NULL;
+    tblk->lbl = (struct id_entry *) NULL;
     tblk->lbblk = (llvm::BasicBlock *) NULL;
 
     /* return the pointer to the block */
@@ -116,144 +165,76 @@ struct bblk *newblk(char *label) {
 }
 
 /*
- * freeblk - frees up the space for a basic block
+ * findbpair - return the backpatch pair for blabel that has not been used
+ *             yet, or NULL
  */
-void freeblk(struct bblk *cblk) {
-    struct quadline *ptr, *dptr, *ptr2, *dptr2;
+struct bpair *findbpair(char *blabel) {
+    void **vp;
 
-    /* free label */
-    if (cblk->label)
-        free(cblk->label);
-
-    /* free blists */
-    freeblist(cblk->preds);
-    freeblist(cblk->succs);
-
-    /* free assemlines */
-    for (ptr = cblk->lines; ptr; ptr = dptr) {
-        dptr = ptr->next;
-
-        for (ptr2 = ptr; ptr2;) {
-            dptr2 = ptr2;
-            ptr2 = ptr2->next;
-            freeline(dptr2);
-        }
-    }
-    free(cblk);
+    if (!(vp = amfind(&pairs, blabel)))
+        return (struct bpair *) NULL;
+    return (struct bpair *) *vp;
 }
 
 /*
- * inblist - check if a block is in a blist
+ * usebpair - mark the backpatch pair for blabel as used
  */
-int inblist(struct blist *head, struct bblk *cblk) {
-    struct blist *bptr;
+void usebpair(char *blabel) {
+    void **vp;
 
-    for (bptr = head; bptr; bptr = bptr->next)
-        if (bptr->ptr == cblk)
-            return true;
-    return false;
+    if ((vp = amfind(&pairs, blabel)))
+        *vp = NULL;
 }
 
 /*
- * freeblist - free up the space for a blist
- */
-void freeblist(struct blist *head) {
-    struct blist *bptr, *dptr;
-
-    for (bptr = head; bptr;) {
-        dptr = bptr;
-        bptr = bptr->next;
-        free(dptr);
-    }
-}
-
-/*
- * inbplist - check if a label exists in the list
- */
-struct bplist *inbplist(struct bplist *head, char *blabel) {
-
-    struct bplist *bpptr;
-    for (bpptr = head; bpptr; bpptr = bpptr->next)
-        if (strcmp(bpptr->ptr->bl, blabel) == 0)
-            return bpptr;
-    return nullptr;
-}
-
-/*
- * freebplist - free up the space for a blist
- */
-void freebplist(struct bplist *head) {
-    struct bplist *bptr, *dptr;
-
-    for (bptr = head; bptr;) {
-        dptr = bptr;
-        bptr = bptr->next;
-        free(dptr);
-    }
-}
-
-/*
- * addtobplist - add a basic block to a blist
+ * addtobplist - add a backpatch pair to a bplist, unless blabel already
+ *               has one
  */
 void addtobplist(struct bplist **head, char *blabel, char *tlabel) {
-    struct bplist *bptr;
+    struct bpair *t;
+    struct bplist *bp;
 
-    /* first check that the basic block is not already in the blist */
-    for (bptr = *head; bptr; bptr = bptr->next)
-        if (strcmp(bptr->ptr->bl, blabel) == 0)
-            return;
+    /* first check that the label is not already in the blist */
+    if (amfind(&pairs, blabel))
+        return;
 
     /* allocate the space for the blist element */
-    struct bpair *t = (struct bpair *) alloc(sizeof(struct bpair));
-    struct bplist *bp = (struct bplist *) alloc(sizeof(struct bplist));
-    strcpy(t->bl, blabel);
-    strcpy(t->tl, tlabel);
+    t = (struct bpair *) falloc(sizeof(struct bpair));
+    t->bl = blabel;
+    t->tl = tlabel;
+    amadd(&pairs, blabel, t);
+    bp = (struct bplist *) falloc(sizeof(struct bplist));
     bp->ptr = t;
     bp->next = *head;
     *head = bp;
 }
 
 /*
- * deletefrombplist - add a basic block to a blist
- */
-void deletefrombplist(struct bplist **head, char *blabel) {
-    struct bplist *bptr, *bprev;
-
-    /* first check that the basic block is not already in the blist */
-    if (!*head)
-        return;
-
-    if (strcmp((*head)->ptr->bl, blabel) == 0) {
-        bptr = *head;
-        *head = (*head)->next;
-        free(bptr);
-        return;
-    }
-
-    bprev = *head;
-    for (bptr = bprev->next; bptr; bprev = bptr, bptr = bptr->next)
-        if (strcmp(bptr->ptr->bl, blabel) == 0) {
-            bprev->next = bptr->next;
-            free(bptr);
-            return;
-        }
-}
-
-/*
- * newline - allocate a new assembly line
+ * newline - allocate a new assembly line; text may be NULL for lines whose
+ *           items point into the input buffer
  */
 struct quadline *newline(char *text) {
     struct quadline *tline;
 
     /* allocate space for the assembly line */
-    tline = (struct quadline *) alloc(sizeof(struct quadline));
+    tline = (struct quadline *) falloc(sizeof(struct quadline));
 
     /* initialize the other fields of the assembly line */
-    tline->text = allocstring(text);
+    tline->text = text ? allocstring(text) : (char *) NULL;
     tline->next = tline->prev = (struct quadline *) NULL;
     tline->type = NONE;
+    tline->arith = NONE_AR;
+    tline->rel = NONE_RE;
+    tline->optype = 0;
+    tline->nopnds = 0;
+    tline->res.kind = O_NONE;
+    tline->res.num = 0;
+    tline->res.name = (char *) NULL;
+    tline->res.id = (struct id_entry *) NULL;
+    tline->opnds = (struct operand *) NULL;
     tline->numitems = 0;
     tline->items = (itemarray) NULL;
+    tline->lineno = 0;
     tline->blk = (struct bblk *) NULL;
     tline->val = (llvm::Value *) NULL;
 
@@ -332,10 +313,13 @@ insline(struct bblk *cblk, struct quadline *ptr, char *text) {
  * prevline - return the previous line
  */
 struct quadline *prevline(struct quadline *currline) {
+    extern thread_local struct cfg gcfg;
+    unsigned n = currline->blk->num;
+
     if (currline->prev)
         return currline->prev;
-    else if (currline->blk->preds && !currline->blk->preds->next)
-        return currline->blk->preds->ptr->lineend;
+    else if (gcfg.blocks && gcfg.predoff[n + 1] - gcfg.predoff[n] == 1)
+        return gcfg.blocks[gcfg.pred[gcfg.predoff[n]]]->lineend;
     return (struct quadline *) NULL;
 }
 
@@ -344,106 +328,32 @@ struct quadline *prevline(struct quadline *currline) {
  */
 void delline(struct quadline *ptr) {
     unhookline(ptr);
-    freeline(ptr);
-}
-
-/*
- * freeitemarray - delete the itemarray for this quadline
- */
-void freeitemarray(struct quadline *ptr) {
-    int i;
-
-    for (i = 0; i < ptr->numitems; i++)
-        free(ptr->items[i]);
-    free(ptr->items);
-    ptr->items = NULL;
-}
-
-/*
- * freeline - deallocate an assembly line
- */
-void freeline(struct quadline *ptr) {
-    freeitemarray(ptr);
-    free(ptr->text);
-    free(ptr);
-}
-
-/*
- * addtoblist - add a basic block to a blist
- */
-void addtoblist(struct blist **head, struct bblk *cblk) {
-    struct blist *bptr;
-
-    /* first check that the basic block is not already in the blist */
-    for (bptr = *head; bptr; bptr = bptr->next)
-        if (bptr->ptr == cblk)
-            return;
-
-    /* allocate the space for the blist element */
-    bptr = (struct blist *) alloc(sizeof(struct blist));
-
-    /* link in the block at the head of the list */
-    bptr->ptr = cblk;
-    bptr->next = *head;
-    *head = bptr;
-}
-
-
-/*
- * sortblist - sort the blocks in blist by the block number
- */
-void sortblist(struct blist *head) {
-    struct blist *bptr, *bptr2;
-    struct bblk *tblk;
-
-    for (bptr = head; bptr; bptr = bptr->next)
-        for (bptr2 = bptr->next; bptr2; bptr2 = bptr2->next)
-            if (bptr->ptr->num > bptr2->ptr->num) {
-                tblk = bptr->ptr;
-                bptr->ptr = bptr2->ptr;
-                bptr2->ptr = tblk;
-            }
-}
-
-/*
- * orderpreds - make the predecessors of each block be in ascending order
- */
-void orderpreds() {
-    struct bblk *cblk;
-    extern struct bblk *top;
-
-    for (cblk = top; cblk; cblk = cblk->down)
-        sortblist(cblk->preds);
 }
 
 /*
  * deleteblk - delete a basic block from the list of basic blocks
  */
 void deleteblk(struct bblk *cblk) {
-    extern struct bblk *bot;
+    extern thread_local struct bblk *bot;
 
     /* update bottom block if needed */
     if (cblk == bot)
         bot = cblk->up;
 
-    /* unhook the "up" and "down" pointers */
-    unlinkblk(cblk);
+    /* branches can no longer reach it */
+    if (cblk->label && findtarget(cblk->label) == cblk)
+        *amfind(&labels, cblk->label) = NULL;
 
-    /* unhook preds */
-    delfrompreds_succs(cblk);
-
-    /* unhook succs */
-    delfromsuccs_preds(cblk);
-
-    /* free up the memory */
-    freeblk(cblk);
+    /* unhook the "up" and "down" pointers; blocks are only deleted while
+       the function is read, before it has any edges */
+    unlinkblk(cblk);
 }
 
 /*
  * unlinkblk - unhook a basic block from the list of basic blocks
  */
 void unlinkblk(struct bblk *cblk) {
-    extern struct bblk *top;
+    extern thread_local struct bblk *top;
 
     /* relink a backward pointer to bypass the block to be deleted */
     if (cblk->down)
@@ -457,54 +367,13 @@ void unlinkblk(struct bblk *cblk) {
 }
 
 /*
- * delfrompreds_succs - delete cblk from the successor list of all the
- *                      predecessors of cblk
- */
-void delfrompreds_succs(struct bblk *cblk) {
-    struct blist *curpred;
-
-    for (curpred = cblk->preds; curpred; curpred = curpred->next)
-        if (!delfromblist(&(curpred->ptr->succs), cblk)) {
-            fprintf(stderr, "delfrompreds_succs(), basic block not found.\n");
-            quit(1);
-        }
-}
-
-/*
- * delfromsuccs_preds - delete cblk from the predecessor list of all the  
- *                      successors of cblk
+ * elapsed - wall clock time in seconds from an arbitrary starting point
  */
-void delfromsuccs_preds(struct bblk *cblk) {
-    struct blist *cursucc;
+double elapsed() {
+    struct timespec ts;
 
-    for (cursucc = cblk->succs; cursucc; cursucc = cursucc->next)
-        if (!delfromblist(&(cursucc->ptr->preds), cblk)) {
-            fprintf(stderr, "delfromsuccs_preds(), basic block not found.\n");
-            quit(1);
-        }
-}
-
-/*
- * delfromblist - deletes a block from a blist
- */
-struct bblk *delfromblist(struct blist **head, struct bblk *cblk) {
-    struct bblk *tblk;
-    struct blist *bptr, *pbptr;
-
-    /* check if the basic block already has been allocated */
-    tblk = (struct bblk *) NULL;
-    pbptr = (struct blist *) NULL;
-    for (bptr = *head; bptr; pbptr = bptr, bptr = bptr->next)
-        if (bptr->ptr == cblk) {
-            tblk = bptr->ptr;
-            if (pbptr)
-                pbptr->next = bptr->next;
-            else
-                *head = bptr->next;
-            free(bptr);
-            break;
-        }
-    return tblk;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
 }
 
 /*
@@ -516,11 +385,15 @@ void quit(int flag) {
 
 /* free up the function's dynamically allocated structures */
 void free_func_structs() {
-    struct bblk *cblk, *next;
-    extern struct bblk *top, *bot;
-
-    for (cblk = top; cblk; cblk = next) {
-        next = cblk->down;
-        deleteblk(cblk);
-    }
+    extern thread_local struct bblk *top, *bot;
+    extern thread_local struct bplist *gbp;
+    extern thread_local struct arena *farena;
+    extern thread_local struct cfg gcfg;
+
+    if (farena)
+        freearena(farena);
+    farena = (struct arena *) NULL;
+    top = bot = (struct bblk *) NULL;
+    gbp = (struct bplist *) NULL;
+    memset(&gcfg, 0, sizeof(gcfg));
 }
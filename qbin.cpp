@@ -0,0 +1,337 @@
+/*
+ * binary quads
+ *
+ * qbinaddfunc() records the function readinfunc() just built - its blocks,
+ * their quads and the backpatch pairs not yet applied - and writeqbin()
+ * writes everything recorded as one file.  Quads are recorded as decoded:
+ * operators, operand kinds and immediates go in as they are, and each item
+ * string is put into the pool once.  readbinfunc() rebuilds the same blocks
+ * and quadlines, filling their operands straight from the records, and
+ * interns a pool string the first time an operand names it, so nothing is
+ * parsed or looked up per token.  backpatching() and setupcontrolflow() then
+ * run on it as on text input.  The quads keep no items.
+ */
+#include "qbin.h"
+#include "atom.h"
+#include "misc.h"
+#include "quad.h"
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+extern thread_local struct bblk *top, *bot;
+extern thread_local struct bplist *gbp;
+
+static std::vector<struct qbrecord> qbrecords;
+static std::vector<struct qboperand> qboperands;
+static std::vector<uint32_t> qboffsets;
+static std::string qbpool;
+static std::unordered_map<std::string, uint32_t> qbstrings;
+
+/*
+ * operands of each quad type after the result, as decodequad() sets them;
+ * a call has at least the function
+ */
+static const uint8_t qbnopnds[] = {
+        1, /* ASSIGN */           1, /* UNARY */
+        2, /* BINOP */            1, /* JUMP */
+        2, /* BRANCH */           2, /* LOCAL_ALLOC */
+        1, /* LOCAL_REF */        2, /* FORMAL_ALLOC */
+        1, /* PARAM_REF */        2, /* GLOBAL_ALLOC */
+        1, /* GLOBAL_REF */       0, /* CONSTANT */
+        1, /* STRING */           1, /* FUNC_BEGIN */
+        0, /* FUNC_END */         1, /* FUNC_CALL */
+        2, /* ADDR_ARRAY_INDEX */ 2, /* STORE */
+        1, /* LOAD */             1, /* RETURN */
+        1, /* CVF */              1, /* CVI */
+        0, /* NONE */
+};
+static_assert(sizeof(qbnopnds) / sizeof(qbnopnds[0]) == NONE + 1,
+              "qbnopnds must cover inst_type");
+
+/*
+ * qbstring - put a string into the pool, returning its id
+ */
+static uint32_t qbstring(const char *s) {
+    uint32_t id;
+
+    if (!s)
+        return QBNONAME;
+    auto it = qbstrings.find(s);
+    if (it != qbstrings.end())
+        return it->second;
+    id = qboffsets.size();
+    qboffsets.push_back(qbpool.size());
+    qbpool.append(s);
+    qbpool.push_back('\0');
+    qbstrings.emplace(s, id);
+    return id;
+}
+
+/*
+ * qboperand - append an operand
+ */
+static void qboperand(const struct operand *o) {
+    struct qboperand q;
+
+    memset(&q, 0, sizeof(q));
+    q.kind = o->kind;
+    q.num = o->num;
+    q.name = qbstring(o->name);
+    qboperands.push_back(q);
+}
+
+/*
+ * qbname - append a named operand, such as a label
+ */
+static void qbname(char *name) {
+    struct operand o;
+
+    o.kind = O_NAME;
+    o.num = 0;
+    o.name = name;
+    qboperand(&o);
+}
+
+/*
+ * qbrecord - append a record whose nopnds operands are the ones appended
+ *            next
+ */
+static void qbrecord(int kind, const struct quadline *ptr, size_t nopnds) {
+    struct qbrecord r;
+
+    memset(&r, 0, sizeof(r));
+    r.kind = kind;
+    r.type = ptr ? ptr->type : NONE;
+    r.arith = ptr ? ptr->arith : NONE_AR;
+    r.rel = ptr ? ptr->rel : NONE_RE;
+    r.optype = ptr ? ptr->optype : 0;
+    r.nopnds = nopnds;
+    r.opnds = qboperands.size();
+    qbrecords.push_back(r);
+}
+
+/*
+ * qbinaddfunc - record the current function
+ */
+void qbinaddfunc() {
+    struct bblk *cblk;
+    struct quadline *ptr;
+    struct bplist *bptr;
+    std::vector<struct bpair *> pairs;
+    int i;
+
+    for (cblk = top; cblk; cblk = cblk->down) {
+        qbrecord(QB_BLOCK, (struct quadline *) NULL, cblk->label ? 1 : 0);
+        if (cblk->label)
+            qbname(cblk->label);
+        for (ptr = cblk->lines; ptr; ptr = ptr->next) {
+            qbrecord(QB_QUAD, ptr, ptr->nopnds + 1);
+            qboperand(&ptr->res);
+            for (i = 0; i < ptr->nopnds; i++)
+                qboperand(&ptr->opnds[i]);
+        }
+    }
+
+    /* gbp is newest first; record the pairs in the order they were read */
+    for (bptr = gbp; bptr; bptr = bptr->next)
+        pairs.push_back(bptr->ptr);
+    for (auto it = pairs.rbegin(); it != pairs.rend(); ++it) {
+        qbrecord(QB_PAIR, (struct quadline *) NULL, 2);
+        qbname((*it)->bl);
+        qbname((*it)->tl);
+    }
+    qbrecord(QB_FEND, (struct quadline *) NULL, 0);
+}
+
+/*
+ * writeqbin - write all the recorded functions to out
+ */
+bool writeqbin(FILE *out) {
+    struct qbheader h;
+
+    memcpy(h.magic, QBMAGIC, sizeof(h.magic));
+    h.nrecords = qbrecords.size();
+    h.noperands = qboperands.size();
+    h.nstrings = qboffsets.size();
+    h.poolsize = qbpool.size();
+    fwrite(&h, sizeof(h), 1, out);
+    fwrite(qbrecords.data(), sizeof(struct qbrecord), qbrecords.size(), out);
+    fwrite(qboperands.data(), sizeof(struct qboperand), qboperands.size(),
+           out);
+    fwrite(qboffsets.data(), sizeof(uint32_t), qboffsets.size(), out);
+    fwrite(qbpool.data(), 1, qbpool.size(), out);
+    return fflush(out) == 0 && !ferror(out);
+}
+
+/*
+ * isqbin - check whether the input [begin, end) holds binary quads, of
+ *          this version or another
+ */
+bool isqbin(const char *begin, const char *end) {
+    return end - begin >= 4 && memcmp(begin, QBMAGIC, 3) == 0;
+}
+
+/*
+ * openqbin - check the binary quads in [begin, end) and set up to read
+ *            them; begin must be 4-byte aligned
+ */
+bool openqbin(struct qbin *qf, char *begin, char *end) {
+    const struct qbrecord *r;
+    const struct qboperand *o;
+    struct qbheader h;
+    size_t size;
+    uint32_t i, n;
+
+    if ((size_t) (end - begin) < sizeof(h) ||
+        memcmp(begin, QBMAGIC, sizeof(h.magic)) != 0)
+        return false;
+    memcpy(&h, begin, sizeof(h));
+    size = sizeof(h) + (size_t) h.nrecords * sizeof(struct qbrecord) +
+           (size_t) h.noperands * sizeof(struct qboperand) +
+           (size_t) h.nstrings * sizeof(uint32_t) + h.poolsize;
+    if ((size_t) (end - begin) < size)
+        return false;
+
+    qf->rec = (const struct qbrecord *) (begin + sizeof(h));
+    qf->recend = qf->rec + h.nrecords;
+    qf->operands = (const struct qboperand *) qf->recend;
+    qf->offsets = (const uint32_t *) (qf->operands + h.noperands);
+    qf->pool = (char *) (qf->offsets + h.nstrings);
+    qf->nstrings = h.nstrings;
+    qf->nrecords = h.nrecords;
+
+    /* validate once so that reading needs no checks */
+    if (h.poolsize && qf->pool[h.poolsize - 1] != '\0')
+        return false;
+    for (i = 0; i < h.nstrings; i++)
+        if (qf->offsets[i] >= h.poolsize)
+            return false;
+    for (i = 0; i < h.noperands; i++) {
+        o = &qf->operands[i];
+        if (o->kind > O_STR || (o->name >= h.nstrings && o->name != QBNONAME))
+            return false;
+    }
+    for (i = 0; i < h.nrecords; i++) {
+        r = &qf->rec[i];
+        if ((uint64_t) r->opnds + r->nopnds > h.noperands)
+            return false;
+        switch (r->kind) {
+            case QB_BLOCK:
+                if (r->nopnds > 1 ||
+                    (r->nopnds && qf->operands[r->opnds].name == QBNONAME))
+                    return false;
+                break;
+            case QB_QUAD:
+                if (r->type > NONE || r->arith > NONE_AR || r->rel > NONE_RE)
+                    return false;
+                n = 1 + qbnopnds[r->type];
+                if (r->nopnds < n || (r->type != FUNC_CALL && r->nopnds != n))
+                    return false;
+                break;
+            case QB_PAIR:
+                if (r->nopnds != 2 ||
+                    qf->operands[r->opnds].name == QBNONAME ||
+                    qf->operands[r->opnds + 1].name == QBNONAME)
+                    return false;
+                break;
+            case QB_FEND:
+                break;
+            default:
+                return false;
+        }
+    }
+
+    qf->atoms = (char **) alloc((h.nstrings ? h.nstrings : 1) * sizeof(char *));
+    memset(qf->atoms, 0, h.nstrings * sizeof(char *));
+    return true;
+}
+
+/*
+ * binname - the interned string with the given id, NULL for QBNONAME
+ */
+static inline char *binname(struct qbin *qf, uint32_t id) {
+    if (id == QBNONAME)
+        return (char *) NULL;
+    if (!qf->atoms[id])
+        qf->atoms[id] = internstr(qf->pool + qf->offsets[id]);
+    return qf->atoms[id];
+}
+
+/*
+ * binopnd - fill in an operand from its record
+ */
+static inline void binopnd(struct qbin *qf, struct operand *o,
+                           const struct qboperand *q) {
+    o->kind = (opnd_kind) q->kind;
+    o->num = q->num;
+    o->name = binname(qf, q->name);
+    o->id = (struct id_entry *) NULL;
+}
+
+/*
+ * readbinfunc - rebuild the next function, as readinfunc() would
+ */
+bool readbinfunc(struct qbin *qf) {
+    const struct qbrecord *r;
+    const struct qboperand *o;
+    struct quadline *ptr;
+    struct bblk *tblk;
+    int i;
+
+    if (qf->rec == qf->recend)
+        return false;
+
+    startfunc();
+    top = bot = (struct bblk *) NULL;
+    for (; qf->rec < qf->recend; qf->rec++) {
+        r = qf->rec;
+        o = qf->operands + r->opnds;
+        switch (r->kind) {
+            case QB_BLOCK:
+                tblk = newblk(r->nopnds ? binname(qf, o->name) : (char *) NULL);
+                if (!top)
+                    top = tblk;
+                else {
+                    tblk->up = bot;
+                    bot->down = tblk;
+                }
+                bot = tblk;
+                break;
+            case QB_QUAD:
+                if (!bot)
+                    goto bad;
+                ptr = insline(bot, (struct quadline *) NULL, NULL);
+                ptr->type = (inst_type) r->type;
+                ptr->arith = (arithematic_type) r->arith;
+                ptr->rel = (relational_type) r->rel;
+                ptr->optype = r->optype;
+                binopnd(qf, &ptr->res, o);
+                ptr->nopnds = r->nopnds - 1;
+                ptr->opnds = ptr->nopnds ? (struct operand *) falloc(
+                        ptr->nopnds * sizeof(struct operand)) :
+                                           (struct operand *) NULL;
+                for (i = 0; i < ptr->nopnds; i++)
+                    binopnd(qf, &ptr->opnds[i], o + 1 + i);
+                break;
+            case QB_PAIR:
+                addtobplist(&gbp, binname(qf, o[0].name),
+                            binname(qf, o[1].name));
+                break;
+            case QB_FEND:
+                qf->rec++;
+                if (!top)
+                    goto bad;
+                return true;
+            default:
+                goto bad;
+        }
+    }
+
+bad:
+    fprintf(stderr, "malformed binary quads at record %ld\n",
+            (long) (qf->rec - (qf->recend - qf->nrecords)));
+    quit(1);
+    return false;
+}
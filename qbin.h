@@ -0,0 +1,70 @@
+//
+// binary quads - a compact encoding of the functions read by readinfunc()
+// that can be loaded back into blocks and quadlines without any parsing.
+//
+// layout: header, records, operands, string offsets, string pool.  Quads
+// are stored decoded: a record carries the operator fields of its quad and
+// indexes its operands, the result first, and an operand carries its kind,
+// its number and the id of its name; string i is the NUL-terminated string
+// at pool + offset[i].
+//
+
+#ifndef QUADREADER_QBIN_H
+#define QUADREADER_QBIN_H
+
+#include <cstdint>
+#include <cstdio>
+
+#define QBMAGIC "QBN2"
+#define QBNONAME UINT32_MAX /* name id of an operand without a name */
+
+/* record kinds */
+#define QB_BLOCK 0 /* start a block, operands: label (none if nopnds 0) */
+#define QB_QUAD 1  /* append a quad of type to the block */
+#define QB_PAIR 2  /* backpatch pair, operands: Bn, Ln */
+#define QB_FEND 3  /* end of the function */
+
+struct qbheader {
+    char magic[4];      /* QBMAGIC */
+    uint32_t nrecords;  /* number of records */
+    uint32_t noperands; /* number of operands */
+    uint32_t nstrings;  /* number of strings in the pool */
+    uint32_t poolsize;  /* bytes in the pool */
+};
+
+struct qbrecord {
+    uint8_t kind;    /* QB_BLOCK, QB_QUAD, QB_PAIR or QB_FEND */
+    uint8_t type;    /* inst_type of a quad */
+    uint8_t arith;   /* its arithematic_type */
+    uint8_t rel;     /* its relational_type */
+    uint8_t optype;  /* its T_INT or T_DOUBLE operation */
+    uint8_t pad[3];
+    uint32_t nopnds; /* number of operands, with the result of a quad */
+    uint32_t opnds;  /* index of the first operand */
+};
+
+struct qboperand {
+    uint8_t kind;  /* opnd_kind */
+    uint8_t pad[3];
+    int32_t num;   /* number of a temporary, or the immediate */
+    uint32_t name; /* string id of the item, or QBNONAME */
+};
+
+struct qbin {
+    const struct qbrecord *rec;       /* next record */
+    const struct qbrecord *recend;    /* end of the records */
+    const struct qboperand *operands; /* operands of all the records */
+    const uint32_t *offsets;          /* pool offset of each string */
+    char *pool;                       /* string pool */
+    char **atoms;                     /* interned strings, NULL until used */
+    uint32_t nstrings;                /* number of strings */
+    uint32_t nrecords;                /* number of records */
+};
+
+bool isqbin(const char *, const char *);
+bool openqbin(struct qbin *, char *, char *);
+bool readbinfunc(struct qbin *);
+void qbinaddfunc();
+bool writeqbin(FILE *);
+
+#endif //QUADREADER_QBIN_H
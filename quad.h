@@ -22,12 +22,13 @@
 /* symbol table entry */
 struct id_entry {
     struct id_entry *i_link;    /* pointer to next entry on hash chain */
-    char i_name[MAXLINE];       /* name in string table */
+    char *i_name;               /* name, an interned string */
     int i_type;                 /* type code */
     int i_blevel;               /* block level */
     int i_width;                /* number of words occupied */
     int i_numelem;              /* number of elements if array type */
     int i_scope;                /* scope */
+    bool i_ssa;                 /* scalar kept in SSA values, not memory */
     struct bblk *blk;           /* pointer to basic block */
     llvm::GlobalVariable *gvar; /* llvm GlobalVariable */
     union {
@@ -106,40 +107,97 @@ typedef enum arithematic_type {
     MOD,
     LSHIFT,
     RSHIFT,
+    AND,
+    OR,
     NONE_AR
 } arithematic_type;
 
+/* kinds of decoded operands */
+typedef enum opnd_kind {
+    O_NONE = 0, /* no operand */
+    O_TEMP,     /* temporary, by number */
+    O_NAME,     /* variable, function or label, by name */
+    O_INT,      /* integer immediate */
+    O_STR       /* string constant */
+} opnd_kind;
+
+/*
+ * an operand of a quad, decoded once when the quad is read and bound to
+ * its symbol table entry by installfunc(); temporaries stay unbound and
+ * live in the code generator's register file
+ */
+struct operand {
+    opnd_kind kind;
+    int num;            /* number of a temporary, or the immediate */
+    char *name;         /* the item, an interned string */
+    struct id_entry *id; /* its symbol, or NULL */
+};
+
+/*
+ * a quad: its type and decoded operands, which are all code generation
+ * looks at, and the items as read, kept for dumpfunc() and binary quads.
+ * The operands after the result are
+ *   ASSIGN             the constant
+ *   UNARY, LOAD, CVF, CVI, RETURN,
+ *   *_REF              the operand, or the referenced name
+ *   BINOP, STORE,
+ *   ADDR_ARRAY_INDEX   the left and right operands
+ *   FUNC_CALL          the function, then the arguments
+ *   STRING             the string
+ *   JUMP               the target label
+ *   BRANCH             the condition and the target label
+ *   *_ALLOC            type and size, with the name declared as the result
+ *   FUNC_BEGIN         type, with the function as the result
+ */
 struct quadline {
     char *text;
     struct quadline *next;
     struct quadline *prev;
     inst_type type;
-    short numitems;
+    arithematic_type arith;  /* UNARY or BINOP arithmetic operator */
+    relational_type rel;     /* BINOP comparison */
+    char optype;             /* T_INT or T_DOUBLE operation */
+    int nopnds;              /* number of operands after the result */
+    struct operand res;      /* the result */
+    struct operand *opnds;   /* the other operands */
+    int numitems;            /* number of items */
     itemarray items;
+    int lineno;              /* input line, 0 for binary quads */
     struct bblk *blk;
     llvm::Value *val;
 };
 
 struct bblk {
     char *label;
-    unsigned short num;
+    unsigned num;               /* index in the function's cfg */
     struct quadline *lines;
     struct quadline *lineend;
-    struct blist *preds;
-    struct blist *succs;
     struct bblk *up;
     struct bblk *down;
+    struct id_entry *lbl;       /* symbol of its label, set by installfunc() */
     llvm::BasicBlock *lbblk;
 };
 
-struct blist {
-    struct bblk *ptr;
-    struct blist *next;
+#define BLKSLAB 64 /* blocks allocated together */
+
+/*
+ * control flow graph of a function, built by setupcontrolflow(); blocks
+ * are numbered in order, and the successors of block i are
+ * succ[succoff[i]] up to succ[succoff[i + 1]], likewise its predecessors,
+ * which come in ascending order
+ */
+struct cfg {
+    unsigned nblocks;     /* number of blocks */
+    struct bblk **blocks; /* the blocks by number */
+    unsigned *succoff;    /* start of each block's successors, and the end */
+    unsigned *succ;       /* successor block numbers */
+    unsigned *predoff;    /* start of each block's predecessors, and the end */
+    unsigned *pred;       /* predecessor block numbers */
 };
 
 struct bpair {
-    char bl[MAXLINE];
-    char tl[MAXLINE];
+    char *bl; /* backpatch label, Bn */
+    char *tl; /* target label, Ln */
 };
 
 struct bplist {
@@ -147,4 +205,13 @@ struct bplist {
     struct bplist *next;
 };
 
+/* a function read in by readinfunc(), ready for code generation */
+struct qfunc {
+    struct bblk *top;   /* first block in the function */
+    struct bblk *bot;   /* last block in the function */
+    struct bplist *bp;  /* backpatch pairs read */
+    struct cfg cfg;     /* its control flow graph */
+    struct arena *arena; /* storage for all of the above */
+};
+
 #endif//QUADREADER_QUAD_H
@@ -0,0 +1,495 @@
+/*
+ * quad input buffer
+ *
+ * A regular file is mapped copy-on-write in one piece.  Anything else (a
+ * pipe, a terminal) is read in QBLOCKSIZE blocks which are kept until the
+ * buffer is closed.  In both cases every line handed out by nextline() is
+ * NUL-terminated in place and stays valid until closequadbuf(), so the
+ * reader can split it into items without copying them.
+ *
+ * gzip and zstd input is recognized by its magic number and decompressed
+ * into the blocks as they are read, through a QZBUFSIZE buffer of
+ * compressed bytes, so it is never written out in full anywhere.
+ */
+#include "quadinput.h"
+#include "misc.h"
+#include "quadscan.h"
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#define QZBUFSIZE (1 << 18) /* compressed bytes read at a time */
+
+/* compressed input formats */
+enum qzformat { QZ_NONE, QZ_GZIP, QZ_ZSTD };
+
+struct qinflate {
+    enum qzformat format; /* QZ_GZIP or QZ_ZSTD */
+#ifdef HAVE_ZLIB
+    z_stream zs;          /* gzip stream */
+#endif
+#ifdef HAVE_ZSTD
+    ZSTD_DStream *zd;     /* zstd stream */
+#endif
+    char *in;             /* compressed bytes */
+    size_t inpos;         /* next unused byte of in */
+    size_t inlen;         /* bytes in in */
+    bool ineof;           /* no more compressed input */
+    bool done;            /* the last stream has ended */
+};
+
+static const char *const qzname[] = {"none", "gzip", "zstd"};
+
+/*
+ * qzmagic - identify a compressed format from the first n bytes of input
+ */
+static enum qzformat qzmagic(const unsigned char *p, size_t n) {
+    if (n >= 2 && p[0] == 0x1f && p[1] == 0x8b)
+        return QZ_GZIP;
+    if (n >= 4 && p[0] == 0x28 && p[1] == 0xb5 && p[2] == 0x2f && p[3] == 0xfd)
+        return QZ_ZSTD;
+    return QZ_NONE;
+}
+
+/*
+ * openinflate - start decompressing the input; the first n compressed bytes
+ *               have already been read into p
+ */
+static void openinflate(struct quadbuf *qb, enum qzformat format,
+                        const char *p, size_t n) {
+    struct qinflate *z;
+
+    z = (struct qinflate *) alloc(sizeof(struct qinflate));
+    memset(z, 0, sizeof(struct qinflate));
+    z->format = format;
+    z->in = (char *) alloc(QZBUFSIZE);
+    memcpy(z->in, p, n);
+    z->inlen = n;
+    switch (format) {
+#ifdef HAVE_ZLIB
+        case QZ_GZIP:
+            /* 15 + 32: any window size, gzip or zlib header */
+            if (inflateInit2(&z->zs, 15 + 32) != Z_OK) {
+                fprintf(stderr, "openinflate: %s\n", z->zs.msg);
+                quit(1);
+            }
+            break;
+#endif
+#ifdef HAVE_ZSTD
+        case QZ_ZSTD:
+            if (!(z->zd = ZSTD_createDStream())) {
+                fprintf(stderr, "openinflate: cannot create zstd stream\n");
+                quit(1);
+            }
+            ZSTD_initDStream(z->zd);
+            break;
+#endif
+        default:
+            fprintf(stderr, "%s input is not supported by this build\n",
+                    qzname[format]);
+            quit(1);
+    }
+    qb->z = z;
+}
+
+/*
+ * fillinflate - read more compressed input once the buffer is used up
+ */
+static void fillinflate(struct quadbuf *qb) {
+    struct qinflate *z = qb->z;
+    ssize_t n;
+
+    if (z->inpos < z->inlen || z->ineof)
+        return;
+    z->inpos = z->inlen = 0;
+    do
+        n = read(qb->fd, z->in, QZBUFSIZE);
+    while (n < 0 && errno == EINTR);
+    if (n < 0) {
+        perror("fillinflate");
+        quit(1);
+    }
+    if (n == 0)
+        z->ineof = true;
+    z->inlen = n;
+    qb->zbytes += n;
+}
+
+/*
+ * inflateinput - decompress up to n bytes into buf, returning the number
+ *                produced; 0 means the end of the input
+ */
+static ssize_t inflateinput(struct quadbuf *qb, char *buf, size_t n) {
+    struct qinflate *z = qb->z;
+    double t = elapsed();
+    size_t produced = 0;
+
+#if !defined(HAVE_ZLIB) && !defined(HAVE_ZSTD)
+    /* no decompressor: openinflate() has already refused the input */
+    (void) buf;
+    (void) n;
+#endif
+    while (produced == 0 && !z->done) {
+        fillinflate(qb);
+        if (z->inpos == z->inlen) {
+            fprintf(stderr, "%s input is truncated\n", qzname[z->format]);
+            quit(1);
+        }
+        switch (z->format) {
+#ifdef HAVE_ZLIB
+            case QZ_GZIP: {
+                int ret;
+
+                z->zs.next_in = (Bytef *) z->in + z->inpos;
+                z->zs.avail_in = z->inlen - z->inpos;
+                z->zs.next_out = (Bytef *) buf;
+                z->zs.avail_out = n;
+                ret = inflate(&z->zs, Z_NO_FLUSH);
+                if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+                    fprintf(stderr, "gzip input: %s\n",
+                            z->zs.msg ? z->zs.msg : "corrupt data");
+                    quit(1);
+                }
+                z->inpos = z->inlen - z->zs.avail_in;
+                produced = n - z->zs.avail_out;
+                /* concatenated gzip members continue the same input */
+                if (ret == Z_STREAM_END) {
+                    fillinflate(qb);
+                    if (z->inpos == z->inlen)
+                        z->done = true;
+                    else
+                        inflateReset(&z->zs);
+                }
+                break;
+            }
+#endif
+#ifdef HAVE_ZSTD
+            case QZ_ZSTD: {
+                ZSTD_inBuffer in = {z->in, z->inlen, z->inpos};
+                ZSTD_outBuffer out = {buf, n, 0};
+                size_t ret;
+
+                ret = ZSTD_decompressStream(z->zd, &out, &in);
+                if (ZSTD_isError(ret)) {
+                    fprintf(stderr, "zstd input: %s\n", ZSTD_getErrorName(ret));
+                    quit(1);
+                }
+                z->inpos = in.pos;
+                produced = out.pos;
+                /* 0 ends a frame; further frames continue the input */
+                if (ret == 0) {
+                    fillinflate(qb);
+                    if (z->inpos == z->inlen)
+                        z->done = true;
+                }
+                break;
+            }
+#endif
+            default:
+                break;
+        }
+    }
+    qb->ztime += elapsed() - t;
+    return produced;
+}
+
+/*
+ * closeinflate - release the decompressor
+ */
+static void closeinflate(struct quadbuf *qb) {
+    struct qinflate *z = qb->z;
+
+#ifdef HAVE_ZLIB
+    if (z->format == QZ_GZIP)
+        inflateEnd(&z->zs);
+#endif
+#ifdef HAVE_ZSTD
+    if (z->format == QZ_ZSTD)
+        ZSTD_freeDStream(z->zd);
+#endif
+    free(z->in);
+    free(z);
+}
+
+/*
+ * readinput - read up to n bytes of (decompressed) input into buf
+ */
+static ssize_t readinput(struct quadbuf *qb, char *buf, size_t n) {
+    if (qb->z)
+        return inflateinput(qb, buf, n);
+    return read(qb->fd, buf, n);
+}
+
+/*
+ * newblock - start a new block, carrying over the partial line at cur
+ */
+static void newblock(struct quadbuf *qb) {
+    struct qblock *blk;
+    size_t tail = qb->end - qb->cur;
+    size_t size;
+
+    for (size = QBLOCKSIZE; size < 2 * (tail + 1); size *= 2)
+        ;
+    blk = (struct qblock *) alloc(QBLOCKBYTES(size));
+    blk->size = size;
+    blk->next = qb->blocks;
+    qb->blocks = blk;
+    if (tail)
+        memcpy(blk->data, qb->cur, tail);
+    qb->cur = blk->data;
+    qb->end = blk->data + tail;
+}
+
+/*
+ * readblock - read more input, carrying a partial line over to a new block
+ *             when the current one is full
+ */
+static void readblock(struct quadbuf *qb) {
+    struct qblock *blk;
+    ssize_t n;
+
+    /* one byte of every block is kept free for the final NUL */
+    if (!qb->blocks || qb->end == qb->blocks->data + qb->blocks->size - 1)
+        newblock(qb);
+    blk = qb->blocks;
+
+    n = readinput(qb, qb->end, blk->data + blk->size - 1 - qb->end);
+    if (n < 0) {
+        if (errno == EINTR)
+            return;
+        perror("readblock");
+        quit(1);
+    }
+    if (n == 0)
+        qb->eof = true;
+    else
+        qb->end += n;
+}
+
+/*
+ * openquadbuf - set up a buffer reading from fp, mapping it if possible and
+ *               decompressing it if it is compressed
+ */
+bool openquadbuf(struct quadbuf *qb, FILE *fp) {
+    struct stat st;
+    long pagesize = sysconf(_SC_PAGESIZE);
+    unsigned char magic[4];
+    enum qzformat format;
+    size_t nmagic = 0;
+    ssize_t n;
+    void *p;
+
+    memset(qb, 0, sizeof(struct quadbuf));
+    qb->fd = fileno(fp);
+    if (qb->fd < 0)
+        return false;
+
+    /* a file whose last line has no newline and which ends exactly on a
+       page boundary leaves no room to terminate that line, so read it */
+    if (fstat(qb->fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 &&
+        lseek(qb->fd, 0, SEEK_CUR) == 0) {
+        n = pread(qb->fd, magic, sizeof(magic), 0);
+        if (n > 0 && qzmagic(magic, n) != QZ_NONE)
+            goto readmagic;
+        p = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                 qb->fd, 0);
+        if (p != MAP_FAILED) {
+            qb->map = (char *) p;
+            qb->mapsize = st.st_size;
+            if (qb->map[st.st_size - 1] == '\n' || st.st_size % pagesize) {
+                madvise(p, st.st_size, MADV_SEQUENTIAL);
+                qb->cur = qb->map;
+                qb->end = qb->map + st.st_size;
+                qb->eof = true;
+                return true;
+            }
+            munmap(p, st.st_size);
+            qb->map = NULL;
+        }
+    }
+
+    /* the magic number has to be read before anything else can be */
+readmagic:
+    while (nmagic < sizeof(magic)) {
+        n = read(qb->fd, magic + nmagic, sizeof(magic) - nmagic);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        nmagic += n;
+    }
+    qb->zbytes = nmagic;
+    if ((format = qzmagic(magic, nmagic)) != QZ_NONE)
+        openinflate(qb, format, (char *) magic, nmagic);
+    else if (nmagic) {
+        newblock(qb);
+        memcpy(qb->end, magic, nmagic);
+        qb->end += nmagic;
+    } else
+        qb->eof = true;
+    return true;
+}
+
+/*
+ * fillquadbuf - read until at least n bytes are buffered; false if the input
+ *               is shorter than that
+ */
+bool fillquadbuf(struct quadbuf *qb, size_t n) {
+    while ((size_t) (qb->end - qb->cur) < n && !qb->eof)
+        readblock(qb);
+    return (size_t) (qb->end - qb->cur) >= n;
+}
+
+/*
+ * loadquadbuf - read the rest of the input so that it lies in [cur, end)
+ */
+void loadquadbuf(struct quadbuf *qb) {
+    struct qblock *blk;
+    size_t tail, size;
+    ssize_t n;
+
+    if (qb->eof)
+        return;
+
+    tail = qb->cur ? qb->end - qb->cur : 0;
+    for (size = QBLOCKSIZE; size < 2 * (tail + 1); size *= 2)
+        ;
+    blk = (struct qblock *) alloc(QBLOCKBYTES(size));
+    blk->size = size;
+    if (tail)
+        memcpy(blk->data, qb->cur, tail);
+    for (;;) {
+        if (tail == blk->size - 1) {
+            blk->size *= 2;
+            blk = (struct qblock *) realloc(
+                    blk, QBLOCKBYTES(blk->size));
+            if (!blk) {
+                fprintf(stderr, "loadquadbuf: ran out of space\n");
+                quit(1);
+            }
+        }
+        n = readinput(qb, blk->data + tail, blk->size - 1 - tail);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("loadquadbuf");
+            quit(1);
+        }
+        if (n == 0)
+            break;
+        tail += n;
+    }
+    blk->next = qb->blocks;
+    qb->blocks = blk;
+    qb->cur = blk->data;
+    qb->end = blk->data + tail;
+    qb->eof = true;
+}
+
+/*
+ * openquadrange - set up a buffer over the lines [begin, end) of another
+ *                 buffer; lineno is the number of the line before begin
+ */
+void openquadrange(struct quadbuf *qb, char *begin, char *end, int lineno) {
+    memset(qb, 0, sizeof(struct quadbuf));
+    qb->fd = -1;
+    qb->cur = begin;
+    qb->end = end;
+    qb->eof = true;
+    qb->lineno = lineno;
+}
+
+/*
+ * nextline - return the next input line with its newline replaced by a NUL,
+ *            or NULL at end of input; *len is set to the line length
+ */
+char *nextline(struct quadbuf *qb, size_t *len) {
+    char *line, *nl;
+
+    for (;;) {
+        if (qb->cur && (nl = findnewline(qb->cur, qb->end)))
+            break;
+        if (qb->eof) {
+            if (qb->cur == qb->end)
+                return NULL;
+            /* last line without a newline */
+            nl = qb->end;
+            break;
+        }
+        readblock(qb);
+    }
+
+    line = qb->cur;
+    qb->cur = nl < qb->end ? nl + 1 : nl;
+    *nl = '\0';
+    *len = nl - line;
+    qb->lineno++;
+    qb->bytes += qb->cur - line;
+    return line;
+}
+
+/*
+ * releasequadbuf - give back the memory holding the lines already returned;
+ *                  none of them may be used afterwards
+ */
+void releasequadbuf(struct quadbuf *qb) {
+    long pagesize = sysconf(_SC_PAGESIZE);
+    struct qblock *blk, *next;
+    char *end;
+
+    if (qb->map) {
+        /* the lines were written to, so their pages are private copies */
+        if (!qb->released)
+            qb->released = qb->map;
+        end = qb->map + (qb->cur - qb->map) / pagesize * pagesize;
+        if (end > qb->released) {
+            madvise(qb->released, end - qb->released, MADV_DONTNEED);
+            qb->released = end;
+        }
+    }
+
+    /* cur is always in the newest block */
+    if (qb->blocks) {
+        for (blk = qb->blocks->next; blk; blk = next) {
+            next = blk->next;
+            free(blk);
+        }
+        qb->blocks->next = (struct qblock *) NULL;
+    }
+}
+
+/*
+ * compression - name of the input compression format, or NULL if the input
+ *               is not compressed
+ */
+const char *compression(struct quadbuf *qb) {
+    return qb->z ? qzname[qb->z->format] : (const char *) NULL;
+}
+
+/*
+ * closequadbuf - release the input image; no line may be used afterwards
+ */
+void closequadbuf(struct quadbuf *qb) {
+    struct qblock *blk, *next;
+
+    if (qb->map)
+        munmap(qb->map, qb->mapsize);
+    if (qb->z)
+        closeinflate(qb);
+    for (blk = qb->blocks; blk; blk = next) {
+        next = blk->next;
+        free(blk);
+    }
+    memset(qb, 0, sizeof(struct quadbuf));
+}
@@ -0,0 +1,56 @@
+//
+// quad input buffer - reads the quad stream as one or more large in-memory
+// images and hands out lines in place, so quad items can point straight into
+// the input instead of being copied out one token at a time.  gzip and zstd
+// input is decompressed on the fly.
+//
+
+#ifndef QUADREADER_QUADINPUT_H
+#define QUADREADER_QUADINPUT_H
+
+#include "quadscan.h"
+#include <cstddef>
+#include <cstdio>
+
+#define QBLOCKSIZE (1 << 20) /* read size when the input is not mappable */
+
+/* block of input read from a pipe */
+struct qblock {
+    struct qblock *next; /* previously filled block */
+    size_t size;         /* bytes of data, not counting the padding */
+    char data[1];        /* input bytes */
+};
+
+/*
+ * bytes to allocate for a block of size bytes of data; the data is followed
+ * by SCANWIDTH bytes of padding, so the scanner's vector loads at the end
+ * of the last line stay inside the allocation
+ */
+#define QBLOCKBYTES(size) (offsetof(struct qblock, data) + (size) + SCANWIDTH)
+
+struct quadbuf {
+    int fd;                /* input file descriptor */
+    char *cur;             /* start of the next unread line */
+    char *end;             /* one past the last byte read so far */
+    char *map;             /* mmap'ed image of a regular file, or NULL */
+    size_t mapsize;        /* length of the mapping */
+    struct qblock *blocks; /* blocks read from a pipe, newest first */
+    bool eof;              /* no more input can be read */
+    int lineno;            /* number of the line last returned */
+    size_t bytes;          /* bytes in the lines returned so far */
+    struct qinflate *z;    /* decompressor for compressed input, or NULL */
+    size_t zbytes;         /* compressed bytes read */
+    double ztime;          /* seconds spent decompressing */
+    char *released;        /* end of the mapped lines given back */
+};
+
+bool openquadbuf(struct quadbuf *, FILE *);
+char *nextline(struct quadbuf *, size_t *);
+bool fillquadbuf(struct quadbuf *, size_t);
+void loadquadbuf(struct quadbuf *);
+void releasequadbuf(struct quadbuf *);
+void openquadrange(struct quadbuf *, char *, char *, int);
+const char *compression(struct quadbuf *);
+void closequadbuf(struct quadbuf *);
+
+#endif //QUADREADER_QUADINPUT_H
@@ -2,18 +2,31 @@
 #include "quad.h"
 #include "sym.h"
 #include "bitcodegen.h"
+#include "quadinput.h"
+#include "quadscan.h"
+#include "quadreader.h"
+#include "funcreader.h"
+#include "qbin.h"
+#include "atom.h"
+#include <algorithm>
 #include <cassert>
 #include <cstdbool>
+#include <climits>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <thread>
+#include <sys/resource.h>
 
-struct bblk *top = (struct bblk *) NULL;// top block in the function
-struct bblk *bot = (struct bblk *) NULL;// end block in the function
-struct bplist *gbp = (struct bplist *) NULL;
+/* each reader thread builds its own function */
+thread_local struct bblk *top = (struct bblk *) NULL;// top block in the function
+thread_local struct bblk *bot = (struct bblk *) NULL;// end block in the function
+thread_local struct bplist *gbp = (struct bplist *) NULL;
+thread_local struct arena *farena = (struct arena *) NULL;// its storage
+thread_local struct cfg gcfg;                  // its control flow graph
 
-bool readinginfunc;     /* indicates if reading in func */
+thread_local bool readinginfunc;     /* indicates if reading in func */
 static char quad_type_names[][MAXLINE] = {
         "ASSIGN","UNARY","BINOP","JUMP","BRANCH","LOCAL_ALLOC","LOCAL_REF",
         "FORMAL_ALLOC","PARAM_REF","GLOBAL_ALLOC","GLOBAL_REF","CONSTANT",
@@ -23,13 +36,29 @@ static char quad_type_names[][MAXLINE] = {
 
 void dumpblk(struct bblk *cblk) {
     struct quadline *ptr;
-    char locallabel[MAXLINE];
-    if (cblk->label) {
-        sprintf(locallabel, "$%s:", cblk->label);
-        fprintf(stdout, "%s\n", locallabel);
+    unsigned i;
+    if (cblk->label)
+        fprintf(stdout, "$%s:\n", cblk->label);
+    if (gcfg.blocks) {
+        fprintf(stdout, "\t; block %u, preds", cblk->num);
+        for (i = gcfg.predoff[cblk->num]; i < gcfg.predoff[cblk->num + 1]; i++)
+            fprintf(stdout, " %u", gcfg.pred[i]);
+        fprintf(stdout, ", succs");
+        for (i = gcfg.succoff[cblk->num]; i < gcfg.succoff[cblk->num + 1]; i++)
+            fprintf(stdout, " %u", gcfg.succ[i]);
+        fputc('\n', stdout);
     }
     for (ptr = cblk->lines; ptr; ptr = ptr->next) {
-        fprintf(stdout, "\t%s\t;%s\n", ptr->text,quad_type_names[ptr->type]);
+        fputc('\t', stdout);
+        for (int i = 0; i < ptr->numitems; i++)
+            fprintf(stdout, ptr->type == STRING && i == 2 ? " \"%s\"" :
+                            i ? " %s" : "%s", ptr->items[i]);
+        /* binary quads have only their operands */
+        if (!ptr->items && ptr->res.name)
+            fprintf(stdout, "%s :=", ptr->res.name);
+        for (int i = 0; !ptr->items && i < ptr->nopnds; i++)
+            fprintf(stdout, " %s", ptr->opnds[i].name);
+        fprintf(stdout, "\t;%s\n", quad_type_names[ptr->type]);
     }
 }
 
@@ -48,128 +77,556 @@ void dumpbplist() {
     }
 }
 
+/*
+ * patchtarget - swap the target label of a bt or br for the label its Bn
+ *               pair names; each pair is used only once
+ */
+static void patchtarget(struct quadline *ptr) {
+    struct operand *target = &ptr->opnds[ptr->nopnds - 1];
+    struct bpair *bp;
+
+    bp = findbpair(target->name);
+    if (bp) {
+        target->name = bp->tl;
+        /* binary quads have no items */
+        if (ptr->items)
+            ptr->items[ptr->numitems - 1] = bp->tl;
+        usebpair(bp->bl);
+    }
+}
+
+/*
+ * backpatching - point the bt/br ending each block at the label its Bn
+ *                pair names
+ */
 void backpatching() {
     struct bblk *cblk;
-    struct bplist *bptr;
     for (cblk = top; cblk; cblk = cblk->down) {
-        if (cblk->lineend && cblk->lineend->prev) {
-            if (strcmp(cblk->lineend->prev->items[0], "bt") == 0) {
-                bptr = inbplist(gbp, cblk->lineend->prev->items[2]);
-                replacestring(&cblk->lineend->prev->text, bptr->ptr->bl,
-                              bptr->ptr->tl);
-                replacestring(&cblk->lineend->prev->items[2], bptr->ptr->bl,
-                              bptr->ptr->tl);
-                deletefrombplist(&gbp, bptr->ptr->bl);
-            }
+        if (cblk->lineend && cblk->lineend->prev &&
+            cblk->lineend->prev->type == BRANCH)
+            patchtarget(cblk->lineend->prev);
+        if (cblk->lineend && cblk->lineend->type == JUMP)
+            patchtarget(cblk->lineend);
+    }
+}
+
+/*
+ * undefined - report an operand that names nothing
+ */
+static void undefined(struct quadline *ptr, struct operand *o) {
+    if (ptr->lineno)
+        fprintf(stderr, "line %d: ", ptr->lineno);
+    fprintf(stderr, "%s is not defined\n", o->name);
+    quit(1);
+}
+
+/*
+ * branchtarget - the block a bt or br quad goes to
+ */
+static struct bblk *branchtarget(struct quadline *ptr) {
+    struct bblk *tblk;
+
+    tblk = findtarget(ptr->opnds[ptr->nopnds - 1].name);
+    if (!tblk)
+        undefined(ptr, &ptr->opnds[ptr->nopnds - 1]);
+    return tblk;
+}
+
+/*
+ * setupcontrolflow - number the blocks and build the cfg; the edges are
+ *                    the ones bitcodegen() emits: a br goes to its target,
+ *                    with a bt before it to both targets, a block ending
+ *                    in a return goes nowhere and any other block falls
+ *                    through to the next
+ */
+void setupcontrolflow() {
+    struct bblk *cblk, *succs[2];
+    struct quadline *last;
+    unsigned i, j, n, ns, *fill;
+
+    for (n = 0, cblk = top; cblk; cblk = cblk->down)
+        cblk->num = n++;
+    gcfg.nblocks = n;
+    gcfg.blocks = (struct bblk **) falloc(n * sizeof(struct bblk *));
+    gcfg.succoff = (unsigned *) falloc((n + 1) * sizeof(unsigned));
+    gcfg.succ = (unsigned *) falloc(2 * n * sizeof(unsigned));
+    gcfg.predoff = (unsigned *) falloc((n + 1) * sizeof(unsigned));
+    memset(gcfg.predoff, 0, (n + 1) * sizeof(unsigned));
+
+    /* successors, counting the predecessors of each block as we go */
+    for (ns = 0, cblk = top; cblk; cblk = cblk->down) {
+        gcfg.blocks[cblk->num] = cblk;
+        gcfg.succoff[cblk->num] = ns;
+        last = cblk->lineend;
+        i = 0;
+        if (last && last->type == JUMP) {
+            if (last->prev && last->prev->type == BRANCH)
+                succs[i++] = branchtarget(last->prev);
+            if (!last->prev || last->prev->type != RETURN)
+                succs[i++] = branchtarget(last);
+        } else if (last && last->type == BRANCH) {
+            succs[i++] = branchtarget(last);
+            if (cblk->down)
+                succs[i++] = cblk->down;
+        } else if (!last || last->type != RETURN) {
+            if (cblk->down)
+                succs[i++] = cblk->down;
         }
-        if (cblk->lineend && strcmp(cblk->lineend->items[0], "br") == 0) {
-            bptr = inbplist(gbp, cblk->lineend->items[1]);
-            if (bptr) {
-                replacestring(&cblk->lineend->text, bptr->ptr->bl,
-                              bptr->ptr->tl);
-                replacestring(&cblk->lineend->items[1], bptr->ptr->bl,
-                              bptr->ptr->tl);
-                deletefrombplist(&gbp, bptr->ptr->bl);
-            }
+        if (i == 2 && succs[0] == succs[1])
+            i = 1;
+        for (j = 0; j < i; j++) {
+            gcfg.succ[ns++] = succs[j]->num;
+            gcfg.predoff[succs[j]->num + 1]++;
         }
     }
+    gcfg.succoff[n] = ns;
+
+    /* predecessors, in block order */
+    for (i = 0; i < n; i++)
+        gcfg.predoff[i + 1] += gcfg.predoff[i];
+    gcfg.pred = (unsigned *) falloc((ns ? ns : 1) * sizeof(unsigned));
+    fill = (unsigned *) alloc((n ? n : 1) * sizeof(unsigned));
+    memcpy(fill, gcfg.predoff, n * sizeof(unsigned));
+    for (i = 0; i < n; i++)
+        for (j = gcfg.succoff[i]; j < gcfg.succoff[i + 1]; j++)
+            gcfg.pred[fill[gcfg.succ[j]]++] = i;
+    free(fill);
 }
 
-struct bblk *findtarget(char *label) {
-    struct bblk *cblk = top;
-    for (; cblk; cblk = cblk->down)
-        if (cblk->label && strcmp(cblk->label, label) == 0)
-            return cblk;
-    return nullptr;
+/* keywords that select the form of a quad line */
+enum quadkey {
+    K_NONE = 0,
+    K_ALLOC,
+    K_ASSIGN,
+    K_BGNSTMT,
+    K_BR,
+    K_BT,
+    K_CVF,
+    K_CVI,
+    K_FEND,
+    K_FF,
+    K_FI,
+    K_FORMAL,
+    K_FUNC,
+    K_GLOBAL,
+    K_LABEL,
+    K_LOCAL,
+    K_LOCALLOC,
+    K_PARAM
+};
+
+/*
+ * keyword - look up an item in the quad keyword set
+ */
+static enum quadkey keyword(const char *s) {
+    switch (*s) {
+        case ':':
+            return s[1] == '=' && !s[2] ? K_ASSIGN : K_NONE;
+        case 'a':
+            return strcmp(s, "alloc") == 0 ? K_ALLOC : K_NONE;
+        case 'b':
+            if (s[1] && !s[2])
+                return s[1] == 't' ? K_BT : s[1] == 'r' ? K_BR : K_NONE;
+            return strcmp(s, "bgnstmt") == 0 ? K_BGNSTMT : K_NONE;
+        case 'c':
+            if (s[1] == 'v' && s[2] && !s[3])
+                return s[2] == 'f' ? K_CVF : s[2] == 'i' ? K_CVI : K_NONE;
+            return K_NONE;
+        case 'f':
+            if (s[1] && !s[2])
+                return s[1] == 'i' ? K_FI : s[1] == 'f' ? K_FF : K_NONE;
+            if (strcmp(s, "func") == 0)
+                return K_FUNC;
+            if (strcmp(s, "fend") == 0)
+                return K_FEND;
+            return strcmp(s, "formal") == 0 ? K_FORMAL : K_NONE;
+        case 'g':
+            return strcmp(s, "global") == 0 ? K_GLOBAL : K_NONE;
+        case 'l':
+            if (strcmp(s, "local") == 0)
+                return K_LOCAL;
+            if (strcmp(s, "label") == 0)
+                return K_LABEL;
+            return strcmp(s, "localloc") == 0 ? K_LOCALLOC : K_NONE;
+        case 'p':
+            return strcmp(s, "param") == 0 ? K_PARAM : K_NONE;
+        default:
+            return K_NONE;
+    }
 }
 
-void setupcontrolflow() {
-    struct bblk *cblk, *tblk;
-    for (cblk = top; cblk; cblk = cblk->down) {
-        if (cblk->lineend) {
-            char *target = nullptr;
-            if (strcmp(cblk->lineend->items[0], "br") == 0) {
-                target = cblk->lineend->items[1];
-                tblk = findtarget(target);
-                assert(tblk && "setupcontrolflow cannot locate target block");
-                addtoblist(&cblk->succs, tblk);
-                addtoblist(&tblk->preds, cblk);
-            } else if (strcmp(cblk->lineend->items[0], "bt") == 0) {
-                target = cblk->lineend->items[2];
-                tblk = findtarget(target);
-                assert(tblk && "setupcontrolflow cannot locate target block");
-                addtoblist(&cblk->succs, tblk);
-                addtoblist(&tblk->preds, cblk);
-                continue;
-            } else if (strncmp(cblk->lineend->items[0], "ret", 3) == 0)
+static thread_local char **qitems;     /* items of the current line */
+static thread_local int maxqitems = 0; /* number of entries allocated for qitems */
+
+/*
+ * splitquad - split a line of len bytes in place into whitespace separated
+ *             items in a single pass; a quoted string is one item without
+ *             its quotes and *quoted is set to its index (or -1)
+ */
+static int splitquad(char *line, size_t len, int *quoted) {
+    int n = 0;
+    size_t pos, i;
+    unsigned blank, m;
+    bool intoken = false, restart;
+    char *p, *q;
+
+    *quoted = -1;
+    for (pos = 0; pos < len;) {
+        /* item boundaries are the 0->1 and 1->0 edges of the blank mask */
+        blank = blankmask(line + pos, len - pos);
+        m = intoken ? blank : ~blank;
+        restart = false;
+        while (m) {
+            i = __builtin_ctz(m);
+            p = line + pos + i;
+            if (intoken) {
+                *p = '\0';
+                intoken = false;
+                m = ~blank & ~((2u << i) - 1);
                 continue;
+            }
+            if (n == maxqitems) {
+                maxqitems = maxqitems ? 2 * maxqitems : MAXNUMITEMS;
+                qitems = (char **) realloc(qitems, maxqitems * sizeof(char *));
+                if (!qitems) {
+                    fprintf(stderr, "splitquad: ran out of space\n");
+                    quit(1);
+                }
+            }
+            if (*p == '"' && *quoted < 0) {
+                /* a string may hold blanks, so resume after its quote */
+                *quoted = n;
+                qitems[n++] = p + 1;
+                if (!(q = (char *) memchr(p + 1, '"', len - (p + 1 - line))))
+                    q = line + len;
+                *q = '\0';
+                pos = q + 1 - line;
+                restart = true;
+                break;
+            }
+            qitems[n++] = p;
+            intoken = true;
+            m = blank & ~((2u << i) - 1);
         }
-        addtoblist(&cblk->succs, cblk->down);
-        if (cblk->down)
-            addtoblist(&cblk->down->preds, cblk);
+        if (!restart)
+            pos += SCANWIDTH;
+    }
+    return n;
+}
+
+/*
+ * assigntype - classify a "t := ..." quad by its operator item and shape
+ */
+static inst_type assigntype(char **items, int numitems, int quoted) {
+    char *op = items[2];
+
+    if (quoted == 2)
+        return STRING;
+    switch (keyword(op)) {
+        case K_LOCAL:
+            return numitems >= 5 ? LOCAL_REF : NONE;
+        case K_PARAM:
+            return numitems >= 5 ? PARAM_REF : NONE;
+        case K_FI:
+        case K_FF:
+            return numitems >= 5 ? FUNC_CALL : NONE;
+        case K_GLOBAL:
+            return numitems == 4 ? GLOBAL_REF : NONE;
+        case K_CVF:
+            return numitems == 4 ? CVF : NONE;
+        case K_CVI:
+            return numitems == 4 ? CVI : NONE;
+        default:
+            break;
+    }
+    switch (numitems) {
+        case 3:
+            return ASSIGN;
+        case 4:
+            if (*op == '@')
+                return LOAD;
+            if (*op == '-' && (op[1] == 'i' || op[1] == 'f') && !op[2])
+                return UNARY;
+            return NONE;
+        case 5:
+            if (*items[3] == '[')
+                return ADDR_ARRAY_INDEX;
+            if (*items[3] == '=' && (items[3][1] == 'i' || items[3][1] == 'f'))
+                return STORE;
+            return BINOP;
+        default:
+            return NONE;
     }
+}
+
+/*
+ * setopnd - decode an item as an operand of the given kind; a value is a
+ *           temporary if it is named like one
+ */
+static void setopnd(struct operand *o, char *item, opnd_kind kind) {
+    o->name = item;
+    o->num = 0;
+    o->id = (struct id_entry *) NULL;
+    if (kind == O_INT)
+        o->num = atoi(item);
+    else if (kind == O_TEMP) {
+        o->num = atomof(item)->temp;
+        if (o->num < 0)
+            kind = O_NAME;
+    }
+    o->kind = kind;
+}
+
+/* operators of BINOP quads, less their i or f suffix */
+static const struct {
+    char name[3];
+    arithematic_type arith;
+    relational_type rel;
+    bool intonly; /* no double form */
+} binops[] = {
+        {"+", ADD, NONE_RE, false},     {"-", SUB, NONE_RE, false},
+        {"*", MUL, NONE_RE, false},     {"/", DIV, NONE_RE, false},
+        {"%", MOD, NONE_RE, false},     {"<<", LSHIFT, NONE_RE, true},
+        {">>", RSHIFT, NONE_RE, true},  {"&", AND, NONE_RE, true},
+        {"|", OR, NONE_RE, true},       {"==", NONE_AR, EQ, false},
+        {"!=", NONE_AR, NE, false},     {"<", NONE_AR, LT, false},
+        {">", NONE_AR, GT, false},      {"<=", NONE_AR, LE, false},
+        {">=", NONE_AR, GE, false},
 };
 
 /*
- * makeinstitems - make the items associated with an instruction
+ * setoper - decode a UNARY or BINOP operator item into the operator and
+ *           the type of the operation; false if it is not one
  */
-void makeinstitems(char *text, short numitems, char stems[][MAXLINE],
-                   itemarray *items) {
+static bool setoper(struct quadline *ptr, const char *op) {
+    size_t len = strlen(op), i;
+
+    if (len < 2 || (op[len - 1] != 'i' && op[len - 1] != 'f'))
+        return false;
+    ptr->optype = op[len - 1] == 'i' ? T_INT : T_DOUBLE;
+    if (ptr->type == UNARY) {
+        /* negation */
+        ptr->arith = SUB;
+        return len == 2 && *op == '-';
+    }
+    for (i = 0; i < sizeof(binops) / sizeof(binops[0]); i++)
+        if (strlen(binops[i].name) == len - 1 &&
+            strncmp(binops[i].name, op, len - 1) == 0) {
+            ptr->arith = binops[i].arith;
+            ptr->rel = binops[i].rel;
+            return !binops[i].intonly || ptr->optype == T_INT;
+        }
+    return false;
+}
+
+/*
+ * decodequad - decode the items of a quad into its operands; false if the
+ *              quad does not have the items its type needs
+ */
+static bool decodequad(struct quadline *ptr) {
+    static const short minitems[] = {
+            3, /* ASSIGN */           4, /* UNARY */
+            5, /* BINOP */            2, /* JUMP */
+            3, /* BRANCH */           4, /* LOCAL_ALLOC */
+            4, /* LOCAL_REF */        4, /* FORMAL_ALLOC */
+            4, /* PARAM_REF */        4, /* GLOBAL_ALLOC */
+            4, /* GLOBAL_REF */       0, /* CONSTANT */
+            3, /* STRING */           3, /* FUNC_BEGIN */
+            1, /* FUNC_END */         5, /* FUNC_CALL */
+            5, /* ADDR_ARRAY_INDEX */ 5, /* STORE */
+            4, /* LOAD */             2, /* RETURN */
+            4, /* CVF */              4, /* CVI */
+            0, /* NONE */
+    };
+    char **items = ptr->items;
+    int i, n;
+
+    if ((unsigned) ptr->type >= sizeof(minitems) / sizeof(minitems[0]) ||
+        ptr->numitems < minitems[ptr->type])
+        return false;
+    switch (ptr->type) {
+        case ASSIGN:
+        case UNARY:
+        case BINOP:
+        case LOCAL_REF:
+        case PARAM_REF:
+        case GLOBAL_REF:
+        case STRING:
+        case FUNC_CALL:
+        case ADDR_ARRAY_INDEX:
+        case STORE:
+        case LOAD:
+        case CVF:
+        case CVI:
+            setopnd(&ptr->res, items[0], O_TEMP);
+            break;
+        default:
+            break;
+    }
+    switch (ptr->type) {
+        case JUMP:
+        case RETURN:
+        case ASSIGN:
+        case STRING:
+        case LOAD:
+        case CVF:
+        case CVI:
+        case UNARY:
+        case LOCAL_REF:
+        case PARAM_REF:
+        case GLOBAL_REF:
+        case FUNC_BEGIN:
+            ptr->nopnds = 1;
+            break;
+        case FUNC_CALL:
+            if ((n = atoi(items[4])) < 0 || n > ptr->numitems - 5)
+                return false;
+            ptr->nopnds = n + 1;
+            break;
+        case FUNC_END:
+        case CONSTANT:
+        case NONE:
+            ptr->nopnds = 0;
+            break;
+        default:
+            ptr->nopnds = 2;
+            break;
+    }
+    ptr->opnds = ptr->nopnds ? (struct operand *) falloc(
+            ptr->nopnds * sizeof(struct operand)) : (struct operand *) NULL;
+
+    switch (ptr->type) {
+        case ASSIGN:
+            setopnd(&ptr->opnds[0], items[2], O_INT);
+            break;
+        case UNARY:
+            if (!setoper(ptr, items[2]))
+                return false;
+            /* fall through */
+        case LOAD:
+        case CVF:
+        case CVI:
+            setopnd(&ptr->opnds[0], items[3], O_TEMP);
+            break;
+        case LOCAL_REF:
+        case PARAM_REF:
+        case GLOBAL_REF:
+            setopnd(&ptr->opnds[0], items[3], O_NAME);
+            break;
+        case BINOP:
+            if (!setoper(ptr, items[3]))
+                return false;
+            /* fall through */
+        case STORE:
+        case ADDR_ARRAY_INDEX:
+            setopnd(&ptr->opnds[0], items[2], O_TEMP);
+            setopnd(&ptr->opnds[1], items[4], O_TEMP);
+            break;
+        case STRING:
+            setopnd(&ptr->opnds[0], items[2], O_STR);
+            break;
+        case FUNC_CALL:
+            setopnd(&ptr->opnds[0], items[3], O_TEMP);
+            for (i = 1; i < ptr->nopnds; i++)
+                setopnd(&ptr->opnds[i], items[4 + i], O_TEMP);
+            break;
+        case JUMP:
+            setopnd(&ptr->opnds[0], items[1], O_NAME);
+            break;
+        case BRANCH:
+            setopnd(&ptr->opnds[0], items[1], O_TEMP);
+            setopnd(&ptr->opnds[1], items[2], O_NAME);
+            break;
+        case RETURN:
+            setopnd(&ptr->opnds[0], items[1], O_TEMP);
+            break;
+        case GLOBAL_ALLOC:
+        case LOCAL_ALLOC:
+        case FORMAL_ALLOC:
+            setopnd(&ptr->res, items[1], O_NAME);
+            setopnd(&ptr->opnds[0], items[2], O_INT);
+            setopnd(&ptr->opnds[1], items[3], O_INT);
+            break;
+        case FUNC_BEGIN:
+            setopnd(&ptr->res, items[1], O_NAME);
+            setopnd(&ptr->opnds[0], items[2], O_INT);
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
+/*
+ * makeinstitems - make the items associated with an instruction and decode
+ *                 them; the items are interned, so equal items are the same
+ *                 pointer
+ */
+static void makeinstitems(struct quadline *ptr, char **stems, int lineno) {
     int i;
-    *items = (itemarray) alloc(numitems * sizeof(char *));
-    for (i = 0; i < numitems; i++)
-        (*items)[i] = allocstring(stems[i]);
+    ptr->items = (itemarray) falloc(ptr->numitems * sizeof(char *));
+    for (i = 0; i < ptr->numitems; i++)
+        ptr->items[i] = internstr(stems[i]);
+    ptr->lineno = lineno;
+    if (!decodequad(ptr)) {
+        fprintf(stderr, "line %d: malformed quadruple\n", lineno);
+        quit(1);
+    }
 }
 
-bool readinfunc(FILE *stdin) {
-    struct quadline *ptr;
+bool readinfunc(struct quadbuf *qb) {
+    struct quadline *ptr = (struct quadline *) NULL;
     struct bblk *tblk, *gblk;
-    char line[MAXLINE], items[MAXNUMITEMS][MAXLINE];
-    char *status;
-    int linebytes;
-    struct id_entry *id;
-    int type, size, offset;
+    char *line, *fname, *p;
+    char **items;
+    size_t len;
+    static char s_retval[] = "retval", s_assign[] = ":=", s_zero[] = "0",
+                s_reti[] = "reti";
+    char *fend[5];
+    int numitems, quoted;
+    long nargs;
+    inst_type itype;
 
+    startfunc();
     gblk = newblk(nullptr);
-    while ((status = fgets(line, MAXLINE, stdin)) != NULL) {
-
-        line[strlen(line) - 1] = '\0';
-        if ((sscanf(line, "alloc %s %d %d", items[1], &type, &size) == 3)) {
-            ptr = insline(gblk, (struct quadline *) NULL, line);
-            ptr->type = GLOBAL_ALLOC;
-            strcpy(items[0],"alloc");
-            ptr->numitems = 2;
-            makeinstitems(ptr->text, 2, items, &ptr->items);
-            id = install(items[1], GLOBAL);
-            if (id == NULL) {
-                fprintf(stderr, "error to enter");
-                assert(0 && "adding global variable to symtab fails");
-            } else {
-                id->i_scope = GLOBAL;
-                id->i_type = type;
-                id->i_width = tsize(type & ~T_ARRAY);
-                id->i_numelem = size / id->i_width;
-            }
-        } else if ((sscanf(line, "func %s %d", items[1], &type) == 2)) {
-            ptr = insline(gblk, (struct quadline *) NULL, line);
-            ptr->type = FUNC_BEGIN;
-            strcpy(items[0],"func");
-            ptr->numitems = 2;
-            makeinstitems(ptr->text, 2, items, &ptr->items);
-            if ((id = install(items[1], GLOBAL)) == NULL)
-                assert(0 && "function cannot be redefined");
-            readinginfunc = true;
-            id->i_type = type | T_PROC;
-            break;
+    while ((line = nextline(qb, &len)) != NULL) {
+        numitems = splitquad(line, len, &quoted);
+        items = qitems;
+        if (numitems == 0)
+            continue;
+
+        switch (keyword(items[0])) {
+            case K_ALLOC:
+                if (numitems < 4)
+                    break;
+                ptr = insline(gblk, (struct quadline *) NULL, NULL);
+                ptr->type = GLOBAL_ALLOC;
+                ptr->numitems = 4;
+                makeinstitems(ptr, items, qb->lineno);
+                break;
+            case K_FUNC:
+                if (numitems < 3)
+                    break;
+                ptr = insline(gblk, (struct quadline *) NULL, NULL);
+                ptr->type = FUNC_BEGIN;
+                ptr->numitems = 3;
+                makeinstitems(ptr, items, qb->lineno);
+                readinginfunc = true;
+                fname = items[1];
+                break;
+            default:
+                break;
         }
+        if (readinginfunc)
+            break;
     }
 
-    if (!status)
+    if (!line)
         return false;
 
     assert(readinginfunc && "No function is found");
 
-    top = bot = newblk(items[1]);
+    top = bot = newblk(fname);
     bot->lines = gblk->lines;
     for (ptr = bot->lines; ptr; ptr=ptr->next) {
         ptr->blk = bot;
@@ -177,167 +634,51 @@ bool readinfunc(FILE *stdin) {
     }
 
     /* read in quadruples for the function */
-    enterblock();
-    while ((status = fgets(line, MAXLINE, stdin))) {
-        linebytes = strlen(line);
-        line[linebytes - 1] = '\0';
-
-        if (sscanf(line, "localloc %s %d %d", items[1], &type, &size) == 3) {
-            ptr = insline(bot, (struct quadline *) NULL, line);
-            ptr->type = LOCAL_ALLOC;
-            ptr->numitems = 2;
-            strcpy(items[0],"localloc");
-            makeinstitems(ptr->text, ptr->numitems, items, &ptr->items);
-
-            id = install(items[1], LOCAL);
-            if (id == NULL)
-                assert(0 && "local variable cannot be redefined");
-            id->i_scope = LOCAL;
-            id->i_type = type;
-            id->i_width = tsize(type & ~T_ARRAY);
-            id->i_numelem = size / id->i_width;
-
-        }
-        else if (sscanf(line, "%s := local %s %d",
-                        items[0], items[3], &offset) == 3) {
-            ptr = insline(bot, (struct quadline *) NULL, line);
-            ptr->type = LOCAL_REF;
-            strcpy(items[1], ":=");
-            strcpy(items[2], "local");
-            ptr->numitems = 4;
-            makeinstitems(ptr->text, ptr->numitems, items, &ptr->items);
-        }
-        else if (sscanf(line, "formal %s %d %d", items[1], &type, &size) == 3) {
-            ptr = insline(bot, (struct quadline *) NULL, line);
-            ptr->type = FORMAL_ALLOC;
-            ptr->numitems = 2;
-            strcpy(items[0],"formal");
-            makeinstitems(ptr->text, ptr->numitems, items, &ptr->items);
-
-            id = install(items[1], PARAM);
-            if (id == NULL)
-                assert(0 && "param variable cannot be redefined");
-            id->i_scope = PARAM;
-            id->i_type = type;
-            id->i_width = tsize(type);
-            id->i_width = tsize(type & ~T_ARRAY);
-            id->i_numelem = size / id->i_width;
-        }
-        else if (sscanf(line, "%s := param %s %d",
-                        items[0],items[3],&offset) == 3) {
-            ptr = insline(bot, (struct quadline *) NULL, line);
-            ptr->type = PARAM_REF;
-            strcpy(items[1], ":=");
-            strcpy(items[2], "param");
-            ptr->numitems = 4;
-            makeinstitems(ptr->text,ptr->numitems, items, &ptr->items);
-        }
-        else if (sscanf(line, "%s %s \"%[^\"]\"",
-                        items[0],items[1],items[2]) == 3) {
-            ptr = insline(bot, (struct quadline *) NULL, line);
-            ptr->type = STRING;
-            ptr->numitems = 3;
-            makeinstitems(ptr->text, ptr->numitems, items, &ptr->items);
-        }
-        else if ((sscanf(line, "%s := fi %s %s %s",
-                         items[0],items[3],items[4],items[5]) == 4) ||
-                 (sscanf(line, "%s := ff %s %s %s",
-                         items[0],items[3],items[4], items[5]) == 4)) {
-
-            ptr = insline(bot, (struct quadline *) NULL, line);
-            ptr->type = FUNC_CALL;
-            int numargs = atoi(items[4]);
-            int i = 5;
-            char *cptr = strstr(line, items[5]);
-            cptr = strtok(cptr, " ");
-            while (cptr) {
-                strcpy(items[i++],cptr);
-                cptr = strtok(NULL, " ");
-            }
-            strcpy(items[1],":=");
-            if (strstr(ptr->text, "fi"))
-                strcpy(items[2],"fi");
-            else
-                strcpy(items[2],"ff");
-            ptr->numitems = numargs + 5;
-            makeinstitems(ptr->text, ptr->numitems, items, &ptr->items);
-        }
-        else if ((sscanf(line, "%s := fi %s %s",
-                         items[0],items[3],items[4]) == 3) ||
-                 (sscanf(line, "%s := ff %s %s",
-                         items[0],items[3],items[4]) == 3)) {
-            ptr = insline(bot, (struct quadline *) NULL, line);
-            ptr->type = FUNC_CALL;
-            int numargs = atoi(items[4]);
-            assert(numargs == 0 && "Number of arguments must be 0");
-            strcpy(items[1],":=");
-            if (strstr(ptr->text, "fi"))
-                strcpy(items[2],"fi");
-            else
-                strcpy(items[2],"ff");
-            ptr->numitems = 5;
-            makeinstitems(ptr->text, ptr->numitems, items, &ptr->items);
-        }
-        else if (sscanf(line, "%s %s %s %s %s",
-                        items[0], items[1], items[2], items[3], items[4]) == 5) {
-            // binary operator
-            ptr = insline(bot, (struct quadline *) NULL, line);
-            ptr->numitems = 5;
-            if (*items[3]=='[')
-                ptr->type = ADDR_ARRAY_INDEX;
-            else if (*items[3] == '=' &&
-                     (items[3][1] == 'i' || items[3][1] == 'f'))
-                ptr->type = STORE;
-            else
-                ptr->type = BINOP;
-            makeinstitems(ptr->text, ptr->numitems, items, &ptr->items);
-        }
-        else if (sscanf(line, "%s %s %s %s",
-                        items[0], items[1], items[2], items[3]) == 4) {
-            ptr = insline(bot, (struct quadline *) NULL, line);
-            if (strcmp(items[2],"global")==0)
-                ptr->type = GLOBAL_REF;
-            else if (*items[2]=='@')
-                ptr->type = LOAD;
-            else if (strcmp(items[2],"cvf")==0)
-                ptr->type = CVF;
-            else if (strcmp(items[2],"cvi")==0)
-                ptr->type = CVI;
-            else if (strcmp(items[2],"-i")==0 ||
-                     strcmp(items[2],"-f")==0)
-                ptr->type = UNARY;
-            else
-                assert(0 && "Unknown quadruple type");
-            ptr->numitems = 4;
-            makeinstitems(ptr->text, ptr->numitems, items, &ptr->items);
+    while ((line = nextline(qb, &len))) {
+        numitems = splitquad(line, len, &quoted);
+        items = qitems;
+        if (numitems == 0) {
+            fprintf(stderr, "Unknown quadruple format");
+            assert(0 && "Unexpected quadruple");
         }
-        else if (sscanf(line, "%s %s %s",
-                        items[0], items[1], items[2]) == 3) {
-            ptr = insline(bot, (struct quadline *) NULL, line);
-            ptr->numitems = 3;
-            makeinstitems(ptr->text, ptr->numitems, items, &ptr->items);
 
-            if (strcmp(items[0], "bt") == 0) {
+        switch (keyword(items[0])) {
+            case K_LOCALLOC:
+                assert(numitems >= 4 && "malformed localloc");
+                ptr = insline(bot, (struct quadline *) NULL, NULL);
+                ptr->type = LOCAL_ALLOC;
+                ptr->numitems = 4;
+                makeinstitems(ptr, items, qb->lineno);
+                break;
+            case K_FORMAL:
+                assert(numitems >= 4 && "malformed formal");
+                ptr = insline(bot, (struct quadline *) NULL, NULL);
+                ptr->type = FORMAL_ALLOC;
+                ptr->numitems = 4;
+                makeinstitems(ptr, items, qb->lineno);
+                break;
+            case K_BT:
                 /* don't create a new basic block since br will follow right
                    after bt.*/
+                assert(numitems == 3 && "malformed bt");
+                ptr = insline(bot, (struct quadline *) NULL, NULL);
                 ptr->type = BRANCH;
-            }
-            else
-                ptr->type = ASSIGN;
-        }
-        else if (sscanf(line, "%s %s", items[0], items[1]) == 2) {
-            if (strcmp(items[0], "bgnstmt") == 0)
-                continue;
-            if (strcmp(items[0], "br") == 0) {
-                ptr = insline(bot, (struct quadline *) NULL, line);
+                ptr->numitems = 3;
+                makeinstitems(ptr, items, qb->lineno);
+                break;
+            case K_BR:
+                assert(numitems == 2 && "malformed br");
+                ptr = insline(bot, (struct quadline *) NULL, NULL);
                 ptr->type = JUMP;
                 ptr->numitems = 2;
-                makeinstitems(ptr->text, ptr->numitems, items, &ptr->items);
+                makeinstitems(ptr, items, qb->lineno);
                 tblk = newblk((char *) NULL);
                 tblk->up = bot;
                 bot->down = tblk;
                 bot = tblk;
-            } else if (strcmp(items[0], "label") == 0) {
+                break;
+            case K_LABEL:
+                assert(numitems == 2 && "malformed label");
                 if (bot->lines || bot->label) {
                     tblk = newblk(items[1]);
                     tblk->up = bot;
@@ -346,44 +687,27 @@ bool readinfunc(FILE *stdin) {
                 } else {
                     assignlabel(bot, items[1]);
                 }
-                auto ib = install(items[1],LOCAL);
-                assert(ib && "symbol table insertion fails");
-                ib->blk = bot;
-            } else if (*items[0] == 'r') {
-                ptr = insline(bot, (struct quadline *) NULL, line);
-                ptr->type = RETURN;
-                ptr->numitems = 2;
-                makeinstitems(ptr->text, ptr->numitems, items, &ptr->items);
-            } else if (*items[0] == 'a') {
-                continue;
-            }
-            else {
-                assert(0 && "Unrecognized quad instruction format");
-            }
-        }
-        else if (sscanf(line, "%s", items[0]) == 1) {
-            //ptr = insline(bot,(struct quadline *)NULL, line);
-            if (strcmp(items[0], "fend") == 0) {
+                break;
+            case K_BGNSTMT:
+                break;
+            case K_FEND:
                 if (!ptr || ptr->type != RETURN) {
                     // insert return 0 statement
-                    char templine[MAXLINE];
-                    sprintf(templine,"retval := 0");
-                    ptr = insline(bot, (struct quadline *)NULL, templine);
+                    ptr = insline(bot, (struct quadline *)NULL, NULL);
                     ptr->type = ASSIGN;
-                    strcpy(items[0],"retval");
-                    strcpy(items[1], ":=");
-                    strcpy(items[2], "0");
+                    fend[0] = s_retval;
+                    fend[1] = s_assign;
+                    fend[2] = s_zero;
                     ptr->numitems = 3;
-                    makeinstitems(ptr->text,ptr->numitems, items, &ptr->items);
-                    sprintf(templine,"reti retval");
-                    ptr = insline(bot, (struct quadline *)NULL, templine);
+                    makeinstitems(ptr, fend, qb->lineno);
+                    ptr = insline(bot, (struct quadline *)NULL, NULL);
                     ptr->type = RETURN;
-                    strcpy(items[0],"reti");
-                    strcpy(items[1], "retval");
+                    fend[0] = s_reti;
+                    fend[1] = s_retval;
                     ptr->numitems = 2;
-                    makeinstitems(ptr->text,ptr->numitems, items, &ptr->items);
+                    makeinstitems(ptr, fend, qb->lineno);
                 }
-                ptr = insline(bot, (struct quadline *) NULL, line);
+                ptr = insline(bot, (struct quadline *) NULL, NULL);
                 ptr->type = FUNC_END;
                 /* clean up last empty block */
                 if (!bot->lines) {
@@ -392,23 +716,58 @@ bool readinfunc(FILE *stdin) {
                     deleteblk(tblk);
                 }
                 ptr->numitems = 1;
-                makeinstitems(ptr->text, ptr->numitems, items, &ptr->items);
+                makeinstitems(ptr, items, qb->lineno);
                 readinginfunc = false;
                 return true;
-            } else {
-                if (sscanf(line, "%[^=]=%[^=]", items[0], items[1]) == 2)
-                    addtobplist(&gbp, items[0], items[1]);
-                else
-                    assert(0 && "unknown quadruple format");
-            }
-        }
-        else {
-            fprintf(stderr, "Unknown quadruple format");
-            assert(0 && "Unexpected quadruple");
+            default:
+                if (numitems > 2 && keyword(items[1]) == K_ASSIGN) {
+                    itype = assigntype(items, numitems, quoted);
+                    if (itype == NONE) {
+                        fprintf(stderr, "line %d: unknown quadruple type\n",
+                                qb->lineno);
+                        assert(0 && "Unknown quadruple type");
+                    }
+                    ptr = insline(bot, (struct quadline *) NULL, NULL);
+                    ptr->type = itype;
+                    if (itype == FUNC_CALL) {
+                        /* the argument count must match the items read */
+                        nargs = strtol(items[4], &p, 10);
+                        if (*p || nargs < 0 || nargs > numitems - 5) {
+                            fprintf(stderr,
+                                    "line %d: malformed quadruple\n",
+                                    qb->lineno);
+                            quit(1);
+                        }
+                        ptr->numitems = nargs + 5;
+                    } else if (itype == LOCAL_REF || itype == PARAM_REF)
+                        ptr->numitems = 4;
+                    else if (itype == STRING)
+                        ptr->numitems = 3;
+                    else
+                        ptr->numitems = numitems;
+                    makeinstitems(ptr, items, qb->lineno);
+                } else if (numitems == 2 && *items[0] == 'r') {
+                    ptr = insline(bot, (struct quadline *) NULL, NULL);
+                    ptr->type = RETURN;
+                    ptr->numitems = 2;
+                    makeinstitems(ptr, items, qb->lineno);
+                } else if (numitems == 2 && *items[0] == 'a') {
+                    /* argi/argf, arguments are taken from the call */
+                } else if (numitems == 1 && (p = strchr(items[0], '=')) &&
+                           p[1]) {
+                    /* backpatch pair Bn=Ln */
+                    *p = '\0';
+                    addtobplist(&gbp, internstr(items[0]), internstr(p + 1));
+                } else {
+                    fprintf(stderr, "line %d: unknown quadruple format\n",
+                            qb->lineno);
+                    assert(0 && "Unrecognized quad instruction format");
+                }
+                break;
         }
     }
 
-    if (!status) {
+    if (!line) {
         fprintf(stderr, "unexpected end of file after function\n");
         quit(1);
     }
@@ -423,20 +782,393 @@ bool readinfunc(FILE *stdin) {
     return true;
 }
 
+/*
+ * bindoperand - bind an operand to the entry lookup() finds for it at
+ *               level blev; a temporary the function never defines is
+ *               looked up by name
+ */
+static void bindoperand(struct quadline *ptr, struct operand *o, int blev,
+                        const char *defined, int lo, int hi) {
+    if (o->kind == O_TEMP && o->num >= lo && o->num <= hi &&
+        defined[o->num - lo])
+        return;
+    if (o->kind != O_TEMP && o->kind != O_NAME)
+        return;
+    if (!(o->id = lookup(o->name, blev)))
+        undefined(ptr, o);
+    o->kind = O_NAME;
+}
+
+/*
+ * bindoperands - bind every operand of the function to its symbol, in the
+ *                order bitcodegen() generates the quads, so code generation
+ *                never looks up a name; a result that is not a temporary
+ *                gets a local of its own, as each assignment always has
+ */
+static void bindoperands() {
+    struct bblk *cblk;
+    struct quadline *ptr;
+    char *defined;
+    int i, lo = INT_MAX, hi = -1;
+
+    for (cblk = top; cblk; cblk = cblk->down)
+        for (ptr = cblk->lines; ptr; ptr = ptr->next)
+            if (ptr->res.kind == O_TEMP) {
+                lo = std::min(lo, ptr->res.num);
+                hi = std::max(hi, ptr->res.num);
+            }
+    defined = (char *) alloc(hi >= lo ? hi - lo + 1 : 1);
+    memset(defined, 0, hi >= lo ? hi - lo + 1 : 1);
+    for (cblk = top; cblk; cblk = cblk->down)
+        for (ptr = cblk->lines; ptr; ptr = ptr->next)
+            if (ptr->res.kind == O_TEMP)
+                defined[ptr->res.num - lo] = 1;
+
+    for (cblk = top; cblk; cblk = cblk->down)
+        for (ptr = cblk->lines; ptr; ptr = ptr->next) {
+            switch (ptr->type) {
+                case GLOBAL_REF:
+                    bindoperand(ptr, &ptr->opnds[0], GLOBAL, defined, lo, hi);
+                    break;
+                case PARAM_REF:
+                    bindoperand(ptr, &ptr->opnds[0], PARAM, defined, lo, hi);
+                    break;
+                case GLOBAL_ALLOC:
+                case LOCAL_ALLOC:
+                case FORMAL_ALLOC:
+                case FUNC_BEGIN:
+                    break;
+                default:
+                    for (i = 0; i < ptr->nopnds; i++)
+                        bindoperand(ptr, &ptr->opnds[i], LOCAL, defined, lo,
+                                    hi);
+                    break;
+            }
+            if (ptr->res.kind == O_NAME && !ptr->res.id) {
+                ptr->res.id = install(ptr->res.name, LOCAL);
+                ptr->res.id->i_scope = LOCAL;
+            }
+        }
+    free(defined);
+}
+
+/*
+ * installfunc - enter the globals, the function, its formals, locals and
+ *               labels read in by readinfunc() into the symbol table and
+ *               bind the operands of its quads; the caller must
+ *               leaveblock() once the function is generated
+ */
+void installfunc() {
+    struct bblk *cblk;
+    struct quadline *ptr;
+    struct id_entry *id;
+    int type;
+
+    for (cblk = top; cblk; cblk = cblk->down) {
+        if (cblk != top) {
+            id = install(cblk->label, LOCAL);
+            assert(id && "symbol table insertion fails");
+            id->blk = cblk;
+            cblk->lbl = id;
+        }
+        for (ptr = cblk->lines; ptr; ptr = ptr->next) {
+            switch (ptr->type) {
+                case GLOBAL_ALLOC:
+                    type = ptr->opnds[0].num;
+                    id = install(ptr->res.name, GLOBAL);
+                    if (id == NULL) {
+                        fprintf(stderr, "error to enter");
+                        assert(0 && "adding global variable to symtab fails");
+                    }
+                    id->i_scope = GLOBAL;
+                    id->i_type = type;
+                    ptr->res.id = id;
+                    id->i_width = tsize(type & ~T_ARRAY);
+                    id->i_numelem = ptr->opnds[1].num / id->i_width;
+                    break;
+                case FUNC_BEGIN:
+                    if ((id = install(ptr->res.name, GLOBAL)) == NULL)
+                        assert(0 && "function cannot be redefined");
+                    id->i_type = ptr->opnds[0].num | T_PROC;
+                    ptr->res.id = id;
+                    enterblock();
+                    break;
+                case LOCAL_ALLOC:
+                    type = ptr->opnds[0].num;
+                    id = install(ptr->res.name, LOCAL);
+                    if (id == NULL)
+                        assert(0 && "local variable cannot be redefined");
+                    id->i_scope = LOCAL;
+                    id->i_type = type;
+                    ptr->res.id = id;
+                    id->i_width = tsize(type & ~T_ARRAY);
+                    id->i_numelem = ptr->opnds[1].num / id->i_width;
+                    break;
+                case FORMAL_ALLOC:
+                    type = ptr->opnds[0].num;
+                    id = install(ptr->res.name, PARAM);
+                    if (id == NULL)
+                        assert(0 && "param variable cannot be redefined");
+                    id->i_scope = PARAM;
+                    id->i_type = type;
+                    ptr->res.id = id;
+                    id->i_width = tsize(type & ~T_ARRAY);
+                    id->i_numelem = ptr->opnds[1].num / id->i_width;
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+    bindoperands();
+}
+
+/* output formats by their -emit names */
+static const struct {
+    const char *name;
+    enum outformat format;
+} formats[] = {
+        {"ll",  OUT_TEXT},
+        {"bc",  OUT_BITCODE},
+        {"obj", OUT_OBJECT},
+        {"asm", OUT_ASM},
+        {"exe", OUT_EXE},
+};
+
+#define NFORMATS (sizeof(formats) / sizeof(formats[0]))
+
+/*
+ * formatname - the -emit name of an output format
+ */
+static const char *formatname(int format) {
+    unsigned i;
+
+    for (i = 0; i < NFORMATS; i++)
+        if (formats[i].format == format)
+            return formats[i].name;
+    return "?";
+}
+
+static void usage(char *prog) {
+    fprintf(stderr, "usage: %s [-time] [-scan avx2|sse2|scalar] [-j threads] "
+                    "[-queue depth] [-stream] [-lean] [-O0|-O1|-O2|-O3|-Os] "
+                    "[-o file] [-emit ll|bc|obj|asm|exe] [-S] [-summary] [-run] "
+                    "[-emit-qbin file.qb] "
+                    "[file.sem|file.qb]\n", prog);
+    exit(1);
+}
+
 int main(int argc, char *argv[]) {
+    struct quadbuf qb;
+    struct funcreader *fr = (struct funcreader *) NULL;
+    struct qfunc f;
+    struct qbin qf;
+    struct rusage ru;
+    FILE *inf = stdin, *qbout = (FILE *) NULL;
+    bool timing = false, binary = false, stream = false, lean = false;
+    bool withsummary = false, run = false;
+    double t, tparse = 0.0, tgen = 0.0, topt, tout, tjit, trun;
+    const char *olevel = "0", *outname = (const char *) NULL;
+    uint64_t outbytes;
+    int format = -1, rc = 0;
+    int i, nthreads = 1, depth = 0;
+    unsigned j;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-time") == 0)
+            timing = true;
+        else if (strcmp(argv[i], "-scan") == 0 && i + 1 < argc) {
+            if (!setscanisa(argv[++i])) {
+                fprintf(stderr, "scanner %s is not available\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            if ((nthreads = atoi(argv[++i])) <= 0)
+                nthreads = std::thread::hardware_concurrency();
+        }
+        else if (strcmp(argv[i], "-stream") == 0)
+            stream = true;
+        else if (strcmp(argv[i], "-lean") == 0 ||
+                 strcmp(argv[i], "--lean") == 0)
+            lean = stream = true;
+        else if (strncmp(argv[i], "-O", 2) == 0) {
+            if (!SetOptLevel(olevel = argv[i] + 2))
+                usage(argv[0]);
+        }
+        else if (strcmp(argv[i], "-queue") == 0 && i + 1 < argc) {
+            if ((depth = atoi(argv[++i])) <= 0)
+                usage(argv[0]);
+        }
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            outname = argv[++i];
+        else if (strcmp(argv[i], "-S") == 0)
+            format = OUT_TEXT;
+        else if (strcmp(argv[i], "-emit") == 0 && i + 1 < argc) {
+            for (j = 0; j < NFORMATS; j++)
+                if (strcmp(argv[i + 1], formats[j].name) == 0)
+                    break;
+            if (j == NFORMATS)
+                usage(argv[0]);
+            format = formats[j].format;
+            i++;
+        }
+        else if (strcmp(argv[i], "-summary") == 0)
+            withsummary = true;
+        else if (strcmp(argv[i], "-run") == 0 ||
+                 strcmp(argv[i], "--run") == 0)
+            run = true;
+        else if (strcmp(argv[i], "-emit-qbin") == 0 && i + 1 < argc) {
+            if (!(qbout = fopen(argv[++i], "wb"))) {
+                perror(argv[i]);
+                return 1;
+            }
+        }
+        else if (argv[i][0] == '-' || inf != stdin)
+            usage(argv[0]);
+        else if (!(inf = fopen(argv[i], "r"))) {
+            perror(argv[i]);
+            return 1;
+        }
+    }
+    if (!openquadbuf(&qb, inf)) {
+        fprintf(stderr, "cannot read quads from input\n");
+        return 1;
+    }
+
+    /* binary quads are loaded whole and read sequentially */
+    t = elapsed();
+    if (fillquadbuf(&qb, 4) && isqbin(qb.cur, qb.end)) {
+        loadquadbuf(&qb);
+        if (!openqbin(&qf, qb.cur, qb.end)) {
+            fprintf(stderr, "malformed binary quads\n");
+            return 1;
+        }
+        binary = true;
+        nthreads = 1;
+        depth = 0;
+    }
+
+    /* convert to binary quads instead of generating code */
+    if (qbout) {
+        for (;;) {
+            gbp = (struct bplist *) NULL;
+            if (!(binary ? readbinfunc(&qf) : readinfunc(&qb)))
+                break;
+            qbinaddfunc();
+            free_func_structs();
+        }
+        if (!writeqbin(qbout) || fclose(qbout) != 0) {
+            perror("writeqbin");
+            return 1;
+        }
+        if (timing)
+            fprintf(stderr, "convert %8.3fs\n", elapsed() - t);
+        closequadbuf(&qb);
+        return 0;
+    }
 
+    /* -run writes no output */
+    if (run && (outname || format >= 0))
+        usage(argv[0]);
+    /* bitcode with -o, text on standard output */
+    if (format < 0)
+        format = outname ? OUT_BITCODE : OUT_TEXT;
+    if (format == OUT_EXE && !outname)
+        usage(argv[0]);
+    if (!OpenOutput(outname, (enum outformat) format, withsummary))
+        return 1;
+    /* only text is written a function at a time */
+    if (format != OUT_TEXT || run)
+        stream = false;
+    if (lean)
+        DiscardValueNames();
     InitializeModuleAndPassManager();
-    //FILE *inf = fopen("test1.sem","r");
-    //FILE *inf = fopen("test1.sem","r");
+    if (stream)
+        StreamModule();
 
-    //while (readinfunc(inf)) {
-    while (readinfunc(stdin)) {
-        backpatching();
-        setupcontrolflow();
+    /* -queue alone reads on a thread of its own, pipelined with codegen */
+    if (nthreads > 1)
+        fr = startparallelreader(&qb, nthreads, depth);
+    else if (depth > 0)
+        fr = startpipelinedreader(&qb, depth);
+    for (;;) {
+        if (fr) {
+            if (!nextfunc(fr, &f))
+                break;
+            top = f.top;
+            bot = f.bot;
+            gbp = f.bp;
+            gcfg = f.cfg;
+            farena = f.arena;
+        } else if (binary) {
+            gbp = (struct bplist *) NULL;
+            if (!readbinfunc(&qf))
+                break;
+            backpatching();
+            setupcontrolflow();
+        } else {
+            gbp = (struct bplist *) NULL;
+            if (!readinfunc(&qb))
+                break;
+            backpatching();
+            setupcontrolflow();
+        }
+        tparse += elapsed() - t;
+        t = elapsed();
+        installfunc();
         //dumpfunc();  // this is for debugging
         bitcodegen();
-        leaveblock(); //matching enterblock() call is made in readinfunc()
+        leaveblock(); //matching enterblock() call is made in installfunc()
+        free_func_structs();
+        if (stream && !fr && !binary)
+            releasequadbuf(&qb); /* the function has been printed */
+        tgen += elapsed() - t;
+        t = elapsed();
+    }
+    tparse += elapsed() - t;
+    if (fr)
+        stopreader(fr);
+    /* streamed functions were optimized as they were generated */
+    topt = OptimizeModule();
+    if (stream)
+        tgen -= topt;
+    if (run)
+        rc = RunModule(&tjit, &trun);
+    else {
+        t = elapsed();
+        outbytes = OutputModule();
+        tout = elapsed() - t;
+    }
+    if (timing && compression(&qb)) {
+        fprintf(stderr, "inflate %8.3fs  %.1f MB %s, %.1f MB/s\n", qb.ztime,
+                qb.zbytes / 1e6, compression(&qb),
+                qb.zbytes / 1e6 / (qb.ztime > 0.0 ? qb.ztime : 1e-9));
+        /* with a reader thread, parse time is only the time spent waiting */
+        if (!fr)
+            tparse -= qb.ztime;
+    }
+    if (timing && binary)
+        fprintf(stderr, "load    %8.3fs  %u records\n", tparse, qf.nrecords);
+    else if (timing)
+        fprintf(stderr, "parse   %8.3fs  %d lines, %.1f MB/s (%s, %d thread%s%s)\n",
+                tparse, qb.lineno,
+                qb.bytes / 1e6 / (tparse > 0.0 ? tparse : 1e-9), scanisa(),
+                nthreads, nthreads > 1 ? "s" : "",
+                nthreads == 1 && depth > 0 ? ", pipelined" : "");
+    if (timing) {
+        fprintf(stderr, "codegen %8.3fs\n", tgen);
+        fprintf(stderr, "opt     %8.3fs  -O%s%s\n", topt, olevel,
+                stream && strcmp(olevel, "0") != 0 ? ", per function" : "");
+        if (run) {
+            fprintf(stderr, "jit     %8.3fs\n", tjit);
+            fprintf(stderr, "run     %8.3fs  exit %d\n", trun, rc);
+        } else
+            fprintf(stderr, "output  %8.3fs  %.1f MB %s\n", tout,
+                    outbytes / 1e6, formatname(format));
+        getrusage(RUSAGE_SELF, &ru);
+        fprintf(stderr, "memory  %8.1f MB peak RSS\n", ru.ru_maxrss / 1024.0);
     }
-    OutputModule();
-    return 0;
+    closequadbuf(&qb);
+    return rc;
 }
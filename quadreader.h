@@ -0,0 +1,16 @@
+//
+// quad reader - builds the basic blocks of one function at a time
+//
+
+#ifndef QUADREADER_QUADREADER_H
+#define QUADREADER_QUADREADER_H
+
+#include "quadinput.h"
+
+bool readinfunc(struct quadbuf *);
+void backpatching();
+void setupcontrolflow();
+void installfunc();
+void dumpfunc();
+
+#endif //QUADREADER_QUADREADER_H
@@ -0,0 +1,204 @@
+/*
+ * quad boundary scanning
+ *
+ * blankmask() classifies SCANWIDTH bytes at once, returning a bit per byte
+ * that is a space or a tab (bytes past the end count as blanks), and
+ * findnewline() looks for the end of a line a vector at a time.  AVX2 and
+ * SSE2 versions are compiled for x86 targets and the best one the CPU
+ * supports is used; everything else gets the scalar versions.  Vector loads
+ * may run past the end of a line: input read into memory is followed by
+ * SCANWIDTH bytes of padding (see QBLOCKBYTES), and a load near the end of
+ * a mapped file, which has none, is copied out first if it would reach into
+ * the next page.
+ */
+#include "quadscan.h"
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_X86
+#endif
+
+#define MINPAGESIZE 4096
+
+struct scanimpl {
+    const char *name;                        /* instruction set */
+    unsigned (*blankmask)(const char *, size_t);
+    char *(*findnewline)(char *, char *);
+};
+
+static unsigned blankmask_scalar(const char *p, size_t n) {
+    unsigned m = 0;
+    size_t i;
+
+    if (n > SCANWIDTH)
+        n = SCANWIDTH;
+    for (i = 0; i < n; i++)
+        if (p[i] == ' ' || p[i] == '\t')
+            m |= 1u << i;
+    if (n < SCANWIDTH)
+        m |= ~0u << n;
+    return m;
+}
+
+static char *findnewline_scalar(char *p, char *end) {
+    for (; p < end; p++)
+        if (*p == '\n')
+            return p;
+    return (char *) NULL;
+}
+
+#ifdef SCAN_X86
+/*
+ * crosspage - check whether a full vector load at p could touch the next
+ *             page; short lines near the end of the input are copied out
+ *             first, everything else is loaded in place and the bytes past
+ *             the line are masked off.  A load that does not cross a page
+ *             may still pass the end of the input, which is why the input
+ *             buffers are padded.
+ */
+static inline bool crosspage(const char *p) {
+    return ((uintptr_t) p & (MINPAGESIZE - 1)) > MINPAGESIZE - SCANWIDTH;
+}
+
+__attribute__((target("sse2")))
+static unsigned blankmask_sse2(const char *p, size_t n) {
+    char tail[SCANWIDTH];
+    unsigned m;
+    __m128i lo, hi;
+    const __m128i sp = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t');
+
+    if (n < SCANWIDTH && crosspage(p)) {
+        memcpy(tail, p, n);
+        p = tail;
+    }
+    lo = _mm_loadu_si128((const __m128i *) p);
+    hi = _mm_loadu_si128((const __m128i *) (p + 16));
+    lo = _mm_or_si128(_mm_cmpeq_epi8(lo, sp), _mm_cmpeq_epi8(lo, tab));
+    hi = _mm_or_si128(_mm_cmpeq_epi8(hi, sp), _mm_cmpeq_epi8(hi, tab));
+    m = (unsigned) _mm_movemask_epi8(lo) |
+        (unsigned) _mm_movemask_epi8(hi) << 16;
+    if (n < SCANWIDTH)
+        m |= ~0u << n;
+    return m;
+}
+
+__attribute__((target("sse2")))
+static char *findnewline_sse2(char *p, char *end) {
+    unsigned m;
+    const __m128i nl = _mm_set1_epi8('\n');
+
+    for (; end - p >= 16; p += 16) {
+        m = _mm_movemask_epi8(
+                _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) p), nl));
+        if (m)
+            return p + __builtin_ctz(m);
+    }
+    return findnewline_scalar(p, end);
+}
+
+__attribute__((target("avx2")))
+static unsigned blankmask_avx2(const char *p, size_t n) {
+    char tail[SCANWIDTH];
+    unsigned m;
+    __m256i x;
+    const __m256i sp = _mm256_set1_epi8(' '), tab = _mm256_set1_epi8('\t');
+
+    if (n < SCANWIDTH && crosspage(p)) {
+        memcpy(tail, p, n);
+        p = tail;
+    }
+    x = _mm256_loadu_si256((const __m256i *) p);
+    x = _mm256_or_si256(_mm256_cmpeq_epi8(x, sp), _mm256_cmpeq_epi8(x, tab));
+    m = (unsigned) _mm256_movemask_epi8(x);
+    if (n < SCANWIDTH)
+        m |= ~0u << n;
+    return m;
+}
+
+__attribute__((target("avx2")))
+static char *findnewline_avx2(char *p, char *end) {
+    unsigned m;
+    const __m256i nl = _mm256_set1_epi8('\n');
+
+    for (; end - p >= 32; p += 32) {
+        m = _mm256_movemask_epi8(_mm256_cmpeq_epi8(
+                _mm256_loadu_si256((const __m256i *) p), nl));
+        if (m)
+            return p + __builtin_ctz(m);
+    }
+    return findnewline_sse2(p, end);
+}
+#endif
+
+/* in order of preference */
+static const struct scanimpl scanimpls[] = {
+#ifdef SCAN_X86
+        {"avx2", blankmask_avx2, findnewline_avx2},
+        {"sse2", blankmask_sse2, findnewline_sse2},
+#endif
+        {"scalar", blankmask_scalar, findnewline_scalar},
+};
+
+/*
+ * scansupported - check whether the CPU can run an implementation
+ */
+static bool scansupported(const struct scanimpl *impl) {
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+    if (strcmp(impl->name, "avx2") == 0)
+        return __builtin_cpu_supports("avx2");
+    if (strcmp(impl->name, "sse2") == 0)
+        return __builtin_cpu_supports("sse2");
+#endif
+    return true;
+}
+
+static const struct scanimpl *pickscan() {
+    const struct scanimpl *impl = scanimpls;
+
+    while (!scansupported(impl))
+        impl++;
+    return impl;
+}
+
+static const struct scanimpl *scan = pickscan();
+
+/*
+ * blankmask - bit i is set if byte i of p is a space or a tab, or i >= n
+ */
+unsigned blankmask(const char *p, size_t n) {
+    return scan->blankmask(p, n);
+}
+
+/*
+ * findnewline - return the first newline in [p, end), or NULL
+ */
+char *findnewline(char *p, char *end) {
+    return scan->findnewline(p, end);
+}
+
+/*
+ * setscanisa - select an instruction set by name; false if the name is
+ *              unknown or the CPU lacks it
+ */
+bool setscanisa(const char *name) {
+    size_t i;
+
+    for (i = 0; i < sizeof(scanimpls) / sizeof(scanimpls[0]); i++)
+        if (strcmp(scanimpls[i].name, name) == 0) {
+            if (!scansupported(&scanimpls[i]))
+                return false;
+            scan = &scanimpls[i];
+            return true;
+        }
+    return false;
+}
+
+/*
+ * scanisa - name of the instruction set in use
+ */
+const char *scanisa() {
+    return scan->name;
+}
@@ -0,0 +1,18 @@
+//
+// quad boundary scanning - finds line ends and item separators in the input
+// 16 or 32 bytes at a time.  The instruction set is picked at run time.
+//
+
+#ifndef QUADREADER_QUADSCAN_H
+#define QUADREADER_QUADSCAN_H
+
+#include <cstddef>
+
+#define SCANWIDTH 32 /* bytes covered by one blankmask() */
+
+unsigned blankmask(const char *, size_t);
+char *findnewline(char *, char *);
+bool setscanisa(const char *);
+const char *scanisa();
+
+#endif //QUADREADER_QUADSCAN_H
@@ -1,14 +1,14 @@
 /* symbol table management */
 
 #include "sym.h"
+#include "atom.h"
 #include "misc.h"
 #include "quad.h"
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 
-#define STABSIZE 119 /* hash table size for strings */
-#define ITABSIZE 37  /* hash table size for identifiers */
+#define ITABMIN 64 /* initial slots in the identifier table */
 
 #define MAXARGS 50
 #define MAXLOCS 50
@@ -21,35 +21,152 @@ int localwidths[MAXLOCS];  /* widths of local variables  */
 
 int level = 0; /* current block level */
 
-struct s_chain {
-    char *s_ptr;               /* string pointer */
-    struct s_chain *s_next;    /* next in chain */
-} * str_table[STABSIZE] = {0}; /* string hash table */
+/*
+ * The identifier table is open-addressed with linear probing.  A slot holds
+ * a name and the entries installed under it, linked through i_link with the
+ * highest block level first, so an inner declaration hides an outer one.
+ * The table doubles when it becomes half full, and a slot whose last entry
+ * is removed is emptied by shifting the rest of its probe run back.
+ *
+ * Every entry installed is also appended to an undo log, and enterblock()
+ * remembers where the log stood, so leaveblock() only has to visit the
+ * entries installed since.
+ */
+struct id_slot {
+    char *name;            /* interned name, NULL if the slot is empty */
+    struct id_entry *ids;  /* entries for name */
+};
+
+static struct id_slot *id_table; /* identifier hash table */
+static unsigned id_mask;         /* number of slots - 1 */
+static unsigned id_used;         /* slots in use */
+
+static struct id_entry **id_log; /* entries in the order installed */
+static unsigned id_nlog;         /* entries in id_log */
+static unsigned id_maxlog;       /* room in id_log */
+static unsigned *id_marks;       /* id_nlog when each level was entered */
+static unsigned id_maxmarks;     /* room in id_marks */
+
+/*
+ * findslot - return the slot of name, or the empty slot where it belongs
+ */
+static struct id_slot *findslot(char *name) {
+    unsigned i;
+
+    for (i = atomof(name)->hash & id_mask; id_table[i].name;
+         i = (i + 1) & id_mask)
+        if (id_table[i].name == name)
+            break;
+    return &id_table[i];
+}
+
+/*
+ * growtable - double the identifier table, or create it
+ */
+static void growtable() {
+    struct id_slot *old = id_table, *sp;
+    unsigned i, n = id_table ? id_mask + 1 : 0;
+
+    id_mask = n ? 2 * n - 1 : ITABMIN - 1;
+    id_table = (struct id_slot *) alloc((id_mask + 1) *
+                                        sizeof(struct id_slot));
+    memset(id_table, 0, (id_mask + 1) * sizeof(struct id_slot));
+    for (i = 0; i < n; i++)
+        if (old[i].name) {
+            sp = findslot(old[i].name);
+            *sp = old[i];
+        }
+    free(old);
+}
+
+/*
+ * emptyslot - empty slot i, moving later slots of its probe run back so
+ *             that every name stays reachable from its home slot
+ */
+static void emptyslot(unsigned i) {
+    unsigned j, home;
 
-struct id_entry *id_table[ITABSIZE] = {0}; /* identifier hash table */
+    for (j = (i + 1) & id_mask; id_table[j].name; j = (j + 1) & id_mask) {
+        home = atomof(id_table[j].name)->hash & id_mask;
+        /* leave slot j alone if its home lies in (i, j] */
+        if (i <= j ? i < home && home <= j : i < home || home <= j)
+            continue;
+        id_table[i] = id_table[j];
+        i = j;
+    }
+    id_table[i].name = (char *) NULL;
+    id_table[i].ids = (struct id_entry *) NULL;
+    id_used--;
+}
+
+/*
+ * growarray - double an array of n elements of the given size, or give it
+ *             initial room
+ */
+static void *growarray(void *old, unsigned *n, unsigned size) {
+    void *a;
+
+    a = alloc((*n ? 2 * *n : 256) * size);
+    if (old)
+        memcpy(a, old, *n * size);
+    free(old);
+    *n = *n ? 2 * *n : 256;
+    return a;
+}
+
+/*
+ * removeentry - take an entry installed since the current block was
+ *               entered out of the table
+ */
+static void removeentry(struct id_entry *ip) {
+    struct id_slot *sp = findslot(ip->i_name);
+    struct id_entry **q;
+
+    for (q = &sp->ids; *q != ip; q = &(*q)->i_link)
+        ;
+    *q = ip->i_link;
+    if (!sp->ids)
+        emptyslot(sp - id_table);
+    free(ip);
+}
 
 /*
  * install - install name with block level blev, return ptr 
  */
 struct id_entry *install(char *name, int blev) {
     struct id_entry *ip, **q;
+    struct id_slot *sp;
 
     if (blev < 0)
         blev = level;
 
     /* allocate space */
     ip = (struct id_entry *) alloc(sizeof(struct id_entry));
+    ip->gvar = nullptr;
+    ip->i_ssa = false;
     ip->u.ltype = nullptr;
     ip->v.b = nullptr;
 
     /* set fields of symbol table */
-    strcpy(ip->i_name,name);
+    ip->i_name = name;
     ip->i_blevel = blev;
-    for (q = &id_table[hash(name) % ITABSIZE]; *q; q = &((*q)->i_link))
+    if (2 * (id_used + 1) > id_mask + 1 || !id_table)
+        growtable();
+    sp = findslot(name);
+    if (!sp->name) {
+        sp->name = name;
+        id_used++;
+    }
+    for (q = &sp->ids; *q; q = &((*q)->i_link))
         if (blev >= (*q)->i_blevel)
             break;
     ip->i_link = *q;
     *q = ip;
+
+    if (id_nlog == id_maxlog)
+        id_log = (struct id_entry **) growarray(id_log, &id_maxlog,
+                                                sizeof(struct id_entry *));
+    id_log[id_nlog++] = ip;
     return (ip);
 }
 
@@ -59,87 +176,53 @@ struct id_entry *install(char *name, int blev) {
 struct id_entry *lookup(char *name, int blev) {
     struct id_entry *p;
 
-    for (p = id_table[hash(name) % ITABSIZE]; p; p = p->i_link)
-        if (strcmp(name, p->i_name)==0 && (blev == 0 || blev == p->i_blevel))
+    if (!id_table)
+        return (NULL);
+    for (p = findslot(name)->ids; p; p = p->i_link)
+        if (blev == 0 || blev == p->i_blevel)
             return (p);
     return (NULL);
 }
 
 /*
- * sdump - dump string table to f
- */
-void sdump(FILE *f) {
-    struct s_chain **s, *p;
-
-    fprintf(f, "Dumping string table\n");
-    for (s = str_table; s < &str_table[STABSIZE]; s++)
-        for (p = *s; p; p = p->s_next)
-            fprintf(f, "%s\n", p->s_ptr);
-}
-
-/*
- * slookup - lookup str in string table, install if necessary, return ptr 
+ * slookup - return the interned copy of str
  */
 char *slookup(char str[]) {
-    struct s_chain *p;
-    int i, k;
-
-    for (k = i = 0; i < 5; i++) /* simple hash function */
-        if (str[i])
-            k += str[i];
-        else
-            break;
-
-    k %= STABSIZE;
-    for (p = str_table[k]; p; p = p->s_next)
-        if (strcmp(str, p->s_ptr) == 0)
-            return (p->s_ptr);
-    p = (struct s_chain *) alloc(sizeof(struct s_chain));
-    p->s_next = str_table[k];
-    str_table[k] = p;
-    p->s_ptr = (char *) alloc((unsigned) strlen(str) + 1);
-    p->s_ptr = strcpy(p->s_ptr, str);
-    return (p->s_ptr);
-}
-
-/*
- * hash - hash name, turn address into hash number
- */
-int hash(char *s) {
-//    int a = 0;
-//    for (int i = 0; s[i] != 0; i++)
-//        a += (int)(s[i]-'0');
-//    return a;
-    int h, a = 117;
-    for (h = 0; *s != 0; s++)
-        h = a*h + *s;
-    return h;
+    return internstr(str);
 }
 
 /*
  * enterblock - enter a new block
  */
 void enterblock() {
-    level++;
+    if ((unsigned) level == id_maxmarks)
+        id_marks = (unsigned *) growarray(id_marks, &id_maxmarks,
+                                          sizeof(unsigned));
+    id_marks[level++] = id_nlog;
 }
 
 /*
- * leaveblock - exit a block
+ * leaveblock - exit a block, removing the entries installed in it at or
+ *              below its level; the rest now belong to the enclosing block
  */
 void leaveblock() {
-    struct id_entry **i, *p, *tmp;
+    struct id_entry *p;
+    unsigned i, mark, kept;
 
     if (level > 0) {
-        for (i = id_table; i < &id_table[ITABSIZE]; i++) {
-            for (p = *i; p; p = tmp)
-                if (p->i_blevel > level)
-                    break;
-                else {
-                    tmp = p->i_link;
-                    free(p);
-                }
-            *i = p;
+        /* newest first, so each entry is usually first on its name */
+        mark = kept = id_marks[level - 1];
+        for (i = id_nlog; i > mark; i--) {
+            p = id_log[i - 1];
+            if (p->i_blevel <= level) {
+                removeentry(p);
+                id_log[i - 1] = (struct id_entry *) NULL;
+            }
         }
+        for (i = mark; i < id_nlog; i++)
+            if (id_log[i])
+                id_log[kept++] = id_log[i];
+        id_nlog = kept;
         level--;
     }
 }
@@ -164,6 +247,7 @@ struct id_entry *dclr(char *name, int type, int width) {
     extern int level;
     char msg[80];
 
+    name = internstr(name);
     if ((p = lookup(name, 0)) == NULL || p->i_blevel != level)
         p = install(name, -1);
     else {
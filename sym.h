@@ -2,10 +2,9 @@
 //void new_block();
 //void exit_block();
 void enterblock();
+/* names given to install() and lookup() must be interned (see atom.h) */
 struct id_entry *install(char *, int);
 void leaveblock();
 struct id_entry *lookup(char *, int);
-//void sdump(FILE *);
 char *slookup(char[]);
-int hash(char *);
 int tsize(int);
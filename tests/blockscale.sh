@@ -0,0 +1,25 @@
+#!/bin/sh
+#
+# blockscale.sh - reading a function must take time linear in its number of
+#                 blocks: branch targets and backpatch pairs are found
+#                 through per-function indexes, not by scanning the blocks
+#
+#   blockscale.sh cgen.exe genquads
+#
+# Parses a main of 10000 and of 100000 if-then diamonds, written by
+# genquads blocks, and requires the larger to take less than 30 times as
+# long.  Linear is 10 times; a scan per branch would be about 100 times.
+#
+cgen=$1
+gen=$2
+. "$(dirname "$0")/common.sh"
+
+parse() {
+    generate blocks "$1"
+    "$cgen" -time "$dir/in.sem" 2>&1 >/dev/null |
+        awk '/^parse/ { print $2 + 0 }'
+}
+small=$(parse 10000)
+large=$(parse 100000)
+echo "parse ${small}s for 10000 diamonds, ${large}s for 100000"
+awk -v s="$small" -v l="$large" 'BEGIN { exit !(l < 30 * s + 0.01) }'
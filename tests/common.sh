@@ -0,0 +1,24 @@
+#
+# common.sh - the start shared by the test and bench scripts, which source
+#             it once they have set gen to genquads, if they need it
+#
+# Stops the script at the first failing command and gives it a scratch
+# directory, $dir, removed when the script exits.
+#
+#   generate args...  write the output of "genquads args..." to $dir/in.sem
+#   benchinput name   generate the bench input, $FUNCS functions (20000 if
+#                     not set), and print its size after name
+#
+set -e
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+funcs=${FUNCS:-20000}
+
+generate() {
+    "$gen" "$@" > "$dir/in.sem"
+}
+
+benchinput() {
+    generate funcs "$funcs"
+    echo "$1: $funcs functions, $(wc -c < "$dir/in.sem") bytes"
+}
@@ -0,0 +1,136 @@
+/*
+ * genquads - write a synthetic quad program to standard output, for tests
+ *            and benchmarks that need inputs larger than the samples
+ *
+ *   genquads funcs N [S]  N small functions with a loop, a branch and a
+ *                         printf call each, and a main calling the last
+ *                         one; the loop body is S statements, 1 if not
+ *                         given
+ *   genquads blocks N     a main of N if-then diamonds in a row, whose
+ *                         branches go through backpatch pairs
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+/*
+ * func - write function number k, whose loop body adds to s stmts times;
+ *        its temporaries, labels and backpatch pairs are numbered from 1,
+ *        as the front end numbers them
+ */
+static void func(int k, int stmts) {
+    int j, t;
+
+    printf("func f%d 1\n", k);
+    printf("formal x 1 4\n");
+    printf("localloc i 1 4\n");
+    printf("localloc s 1 4\n");
+    printf("t1 := local s 0\n");
+    printf("t2 := 0\n");
+    printf("t3 := t1 =i t2\n");
+    printf("t4 := local i 0\n");
+    printf("t5 := t4 =i t2\n");
+    printf("label L1\n");
+    printf("t6 := local i 0\n");
+    printf("t7 := @i t6\n");
+    printf("t8 := param x 0\n");
+    printf("t9 := @i t8\n");
+    printf("t10 := t7 <i t9\n");
+    printf("bt t10 B1\n");
+    printf("br B2\n");
+    printf("label L2\n");
+    printf("t11 := local i 0\n");
+    printf("t12 := @i t11\n");
+    for (j = 0, t = 13; j < stmts; j++, t += 6) {
+        printf("t%d := local s 0\n", t);
+        printf("t%d := @i t%d\n", t + 1, t);
+        printf("t%d := %d\n", t + 2, (k + j) % 97 + 1);
+        printf("t%d := t12 *i t%d\n", t + 3, t + 2);
+        printf("t%d := t%d +i t%d\n", t + 4, t + 1, t + 3);
+        printf("t%d := t%d =i t%d\n", t + 5, t, t + 4);
+    }
+    printf("t%d := 1\n", t);
+    printf("t%d := t12 +i t%d\n", t + 1, t);
+    printf("t%d := t11 =i t%d\n", t + 2, t + 1);
+    printf("br B3\n");
+    printf("label L3\n");
+    printf("t%d := \"f%d %%d\\n\"\n", t + 3, k);
+    printf("t%d := local s 0\n", t + 4);
+    printf("t%d := @i t%d\n", t + 5, t + 4);
+    printf("argi t%d\n", t + 3);
+    printf("argi t%d\n", t + 5);
+    printf("t%d := global printf\n", t + 6);
+    printf("t%d := fi t%d 2 t%d t%d\n", t + 7, t + 6, t + 3, t + 5);
+    printf("reti t%d\n", t + 5);
+    printf("B1=L2\n");
+    printf("B2=L3\n");
+    printf("B3=L1\n");
+    printf("fend\n");
+}
+
+static void funcs(int n, int stmts) {
+    int k;
+
+    for (k = 0; k < n; k++)
+        func(k, stmts);
+    printf("func main 1\n");
+    printf("t1 := 10\n");
+    printf("argi t1\n");
+    printf("t2 := global f%d\n", n - 1);
+    printf("t3 := fi t2 1 t1\n");
+    printf("t4 := 0\n");
+    printf("reti t4\n");
+    printf("fend\n");
+}
+
+/*
+ * blocks - write a main of n diamonds, each testing the variable x and
+ *          either incrementing it or not; main returns x
+ */
+static void blocks(int n) {
+    int k, t;
+
+    printf("func main 1\n");
+    printf("localloc x 1 4\n");
+    printf("t1 := local x 0\n");
+    printf("t2 := 0\n");
+    printf("t3 := t1 =i t2\n");
+    for (k = 0, t = 4; k < n; k++, t += 8) {
+        printf("t%d := local x 0\n", t);
+        printf("t%d := @i t%d\n", t + 1, t);
+        printf("t%d := %d\n", t + 2, k % 3);
+        printf("t%d := t%d >=i t%d\n", t + 3, t + 1, t + 2);
+        printf("bt t%d B%d\n", t + 3, 2 * k + 1);
+        printf("br B%d\n", 2 * k + 2);
+        printf("label L%d\n", 2 * k + 1);
+        printf("t%d := 1\n", t + 4);
+        printf("t%d := t%d +i t%d\n", t + 5, t + 1, t + 4);
+        printf("t%d := t%d =i t%d\n", t + 6, t, t + 5);
+        printf("label L%d\n", 2 * k + 2);
+        printf("B%d=L%d\n", 2 * k + 1, 2 * k + 1);
+        printf("B%d=L%d\n", 2 * k + 2, 2 * k + 2);
+    }
+    printf("t%d := local x 0\n", t);
+    printf("t%d := @i t%d\n", t + 1, t);
+    printf("reti t%d\n", t + 1);
+    printf("fend\n");
+}
+
+int main(int argc, char *argv[]) {
+    int n, stmts = 1;
+
+    if (argc < 3 || argc > 4 || (n = atoi(argv[2])) <= 0 ||
+        (argc == 4 && (stmts = atoi(argv[3])) <= 0)) {
+        fprintf(stderr, "usage: %s funcs|blocks count [stmts]\n", argv[0]);
+        return 1;
+    }
+    if (strcmp(argv[1], "funcs") == 0)
+        funcs(n, stmts);
+    else if (strcmp(argv[1], "blocks") == 0)
+        blocks(n);
+    else {
+        fprintf(stderr, "usage: %s funcs|blocks count [stmts]\n", argv[0]);
+        return 1;
+    }
+    return 0;
+}
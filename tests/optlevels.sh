@@ -0,0 +1,24 @@
+#!/bin/sh
+#
+# optlevels.sh - a program compiled at an optimization level must behave as
+#                it does compiled at -O0: same output, same exit status
+#
+#   optlevels.sh cgen.exe lli file.sem -O1|-O2|-O3|-Os|-O0 [-stream]
+#
+cgen=$1
+lli=$2
+in=$3
+shift 3
+. "$(dirname "$0")/common.sh"
+
+run() {
+    "$cgen" "$@" "$in" > "$dir/out.ll"
+    set +e
+    "$lli" "$dir/out.ll" < /dev/null > "$dir/out"
+    echo "exit $?" >> "$dir/out"
+    set -e
+}
+run -O0
+mv "$dir/out" "$dir/O0.out"
+run "$@"
+diff "$dir/O0.out" "$dir/out"
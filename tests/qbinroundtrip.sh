@@ -0,0 +1,15 @@
+#!/bin/sh
+#
+# qbinroundtrip.sh - converting a quad file to binary quads and loading it
+#                    back must give the same IR as reading the text
+#
+#   qbinroundtrip.sh cgen.exe file.sem
+#
+cgen=$1
+in=$2
+. "$(dirname "$0")/common.sh"
+
+"$cgen" -emit-qbin "$dir/in.qb" "$in"
+"$cgen" "$dir/in.qb" > "$dir/qbin.ll"
+"$cgen" "$in" > "$dir/text.ll"
+diff "$dir/text.ll" "$dir/qbin.ll"
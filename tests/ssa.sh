@@ -0,0 +1,34 @@
+#!/bin/sh
+#
+# ssa.sh - a program whose scalar locals are built into SSA values must
+#          behave as expected and get the expected phis and allocas
+#
+#   ssa.sh cgen.exe lli file.sem phis allocas
+#
+# The expected output and exit status, as the code generator gave them
+# before it built SSA values, are in file.out next to file.sem.
+#
+cgen=$1
+lli=$2
+in=$3
+phis=$4
+allocas=$5
+. "$(dirname "$0")/common.sh"
+
+"$cgen" -O0 "$in" > "$dir/out.ll"
+set +e
+"$lli" "$dir/out.ll" < /dev/null > "$dir/out"
+echo "exit $?" >> "$dir/out"
+set -e
+diff "${in%.sem}.out" "$dir/out"
+
+n=$(grep -c ' = phi ' "$dir/out.ll" || true)
+if [ "$n" -ne "$phis" ]; then
+    echo "$in: $n phis, expected $phis"
+    exit 1
+fi
+n=$(grep -c ' = alloca ' "$dir/out.ll" || true)
+if [ "$n" -ne "$allocas" ]; then
+    echo "$in: $n allocas, expected $allocas"
+    exit 1
+fi
@@ -0,0 +1,26 @@
+#!/bin/sh
+#
+# streamrss.sh - with -stream, peak RSS must stay flat as the number of
+#                functions grows: the input is a regular file, mapped
+#                privately, and the pages of each function are given back
+#                once it has been printed
+#
+#   streamrss.sh cgen.exe genquads
+#
+# The functions are long, so what the module keeps of each, a declaration,
+# is small beside its input.  Without the release the larger run would
+# need all of its 16 MB more input resident at the end.
+#
+cgen=$1
+gen=$2
+. "$(dirname "$0")/common.sh"
+
+rss() {
+    generate funcs "$1" 40
+    "$cgen" -stream -time "$dir/in.sem" 2>&1 >/dev/null |
+        awk '/^memory/ { print int($2) }'
+}
+small=$(rss 500)
+large=$(rss 4000)
+echo "peak RSS ${small} MB for 500 functions, ${large} MB for 4000"
+test "$large" -le $((small + 8))
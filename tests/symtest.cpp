@@ -0,0 +1,146 @@
+/*
+ * symtest - scopes of the symbol table across enterblock() and leaveblock()
+ *
+ * Leaving a block must remove the entries installed in it at or below its
+ * level, bring back the entries they shadowed, and keep the entries
+ * installed in it at a higher level, such as globals declared inside a
+ * function, which then belong to the enclosing block.
+ */
+#include "misc.h"
+#include "quad.h"
+#include "sym.h"
+#include "atom.h"
+#include <cstdio>
+
+/* misc.cpp manages the function being read through these */
+thread_local struct bblk *top = (struct bblk *) NULL;
+thread_local struct bblk *bot = (struct bblk *) NULL;
+thread_local struct bplist *gbp = (struct bplist *) NULL;
+thread_local struct arena *farena = (struct arena *) NULL;
+thread_local struct cfg gcfg;
+
+#define NAMES 1000 /* names in the table while blocks come and go */
+
+static int failures;
+
+#define check(cond)                                                   \
+    do {                                                              \
+        if (!(cond)) {                                                \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__,    \
+                    __LINE__, #cond);                                 \
+            failures++;                                               \
+        }                                                             \
+    } while (0)
+
+/*
+ * name - the interned name prefix followed by n
+ */
+static char *name(const char *prefix, int n) {
+    char buf[32];
+
+    snprintf(buf, sizeof(buf), "%s%d", prefix, n);
+    return internstr(buf);
+}
+
+/*
+ * nested - names installed at the current level shadow those of the
+ *          enclosing blocks until their own block is left
+ */
+static void nested() {
+    struct id_entry *outer, *mid, *inner, *only;
+    char *x = internstr("x"), *y = internstr("y");
+
+    enterblock();
+    outer = install(x, -1);
+    enterblock();
+    mid = install(x, -1);
+    check(lookup(x, 0) == mid);
+    enterblock();
+    inner = install(x, -1);
+    only = install(y, -1);
+    check(lookup(x, 0) == inner);
+    check(lookup(y, 0) == only);
+    leaveblock();
+    check(lookup(x, 0) == mid);
+    check(lookup(y, 0) == NULL);
+    leaveblock();
+    check(lookup(x, 0) == outer);
+    leaveblock();
+    check(lookup(x, 0) == NULL);
+}
+
+/*
+ * function - a function's parameters, locals and labels go away when it
+ *            is left, the globals of the same names stay, and so do
+ *            globals declared inside it
+ */
+static void function() {
+    struct id_entry *gx, *px, *li, *g, *label;
+    char *x = internstr("x"), *i = internstr("i"), *h = internstr("h");
+    char *l = internstr("L1");
+
+    gx = install(x, GLOBAL);
+    enterblock();
+    px = install(x, PARAM);
+    li = install(i, LOCAL);
+    label = install(l, LOCAL);
+    g = install(h, GLOBAL);
+    check(lookup(x, PARAM) == px);
+    check(lookup(x, GLOBAL) == gx);
+    check(lookup(i, 0) == li);
+    check(lookup(l, 0) == label);
+    leaveblock();
+    check(lookup(x, PARAM) == NULL);
+    check(lookup(x, GLOBAL) == gx);
+    check(lookup(x, 0) == gx);
+    check(lookup(i, 0) == NULL);
+    check(lookup(l, 0) == NULL);
+    check(lookup(h, GLOBAL) == g);
+
+    /* the global now belongs to the enclosing block */
+    enterblock();
+    leaveblock();
+    check(lookup(h, GLOBAL) == g);
+}
+
+/*
+ * crowded - removing many entries, while the table grows and probe runs
+ *           are shifted back, loses none of the names left in it
+ */
+static void crowded() {
+    struct id_entry *outer[NAMES];
+    int i, round;
+
+    enterblock();
+    for (i = 0; i < NAMES; i++)
+        outer[i] = install(name("o", i), -1);
+    for (round = 0; round < 3; round++) {
+        enterblock();
+        for (i = 0; i < NAMES; i++) {
+            install(name("n", i), -1);
+            if (i % 2 == 0)
+                install(name("o", i), -1);
+        }
+        for (i = 0; i < NAMES; i += 2)
+            check(lookup(name("o", i), 0) != outer[i]);
+        leaveblock();
+        for (i = 0; i < NAMES; i++) {
+            check(lookup(name("o", i), 0) == outer[i]);
+            check(lookup(name("n", i), 0) == NULL);
+        }
+    }
+    leaveblock();
+    for (i = 0; i < NAMES; i++)
+        check(lookup(name("o", i), 0) == NULL);
+}
+
+int main() {
+    nested();
+    function();
+    crowded();
+    if (failures) {
+        fprintf(stderr, "symtest: %d checks failed\n", failures);
+        return 1;
+    }
+    return 0;
+}